@@ -27,7 +27,6 @@ and potentially send proprietary packets (or something, the datasheet is pretty
 TODO:
 - add example sketch filenames to library.json
 - test platforms other than STM32
-- check Wire.h function return values for I2C errors
 - test if 'static' vars in the ESP32 functions actually are static (connect 2 sensors?)
 - generalized memory map struct (also for other libraries). Could just be an enum, i just don't love #define
 
@@ -36,7 +35,11 @@ TODO:
 #ifndef BQ51_thijs_h
 #define BQ51_thijs_h
 
-#include "Arduino.h" // always import Arduino.h
+#if defined(BQ51_useHostSim) || defined(BQ51_useLinuxI2C)
+  #include "_BQ51_thijs_host.h" // (a host has no Arduino.h, this provides the few things the library needs)
+#else
+  #include "Arduino.h" // always import Arduino.h
+#endif
 
 //#define BQ51debugPrint(x)  Serial.println(x)
 //#define BQ51debugPrint(x)  log_d(x)   //using the ESP32 debug printing
@@ -45,6 +48,9 @@ TODO:
   #define BQ51debugPrint(x)  ;
 #endif
 
+//#define BQ51_noFloat  // remove all float functions/members (use the integer _mV/_mW/_permille ones instead), so soft-float routines are never pulled in (328p, MSP430)
+//#define BQ51_useShadowCache  // keep a copy of the writable registers in RAM, so setters don't need to read before writing (and getters don't need the bus at all)
+
 
 //// BQ51 constants:
 //// configuration registers: (NOTE: these registers will retain their value when V_RECT goes below V_UVLO)
@@ -64,7 +70,7 @@ TODO:
 // #define BQ51_PACKET_PAYLOAD_1    0xF2 // (R/W) Wireless Power Prop Packet Payload RAM Byte 1 Register
 // #define BQ51_PACKET_PAYLOAD_2    0xF3 // (R/W) Wireless Power Prop Packet Payload RAM Byte 2 Register
 // #define BQ51_PACKET_PAYLOAD_3    0xF4 // (R/W) Wireless Power Prop Packet Payload RAM Byte 3 Register
-// #define BQ51_PACKET_PAYLOAD_size   4 // size of Prop Packet Payload RAM Byte registers
+#define BQ51_PACKET_PAYLOAD_size  4 // size of Prop Packet Payload RAM Byte registers
 //// RXID Readback Registers: (6 contiguous bytes)
 #define BQ51_RXID_READBACK       0xF5 // (R/W) Wireless Power Readback Register start (unique ID for each device, programmed at factory) (not on BQ51021(?))
 #define BQ51_RXID_size     6 // size of RXID (i'm pretty sure)
@@ -96,8 +102,15 @@ TODO:
 #define BQ51_IO_REG_default        0b00000111 // 100% IO_REG target, so it's just determined by the resistors used
 #define BQ51_MAILBOX_default       0b10000000 // writing a 0 to the first bit would trigger package transmission
 
-static const float BQ51_VOLT_SCALAR = 0.046; // (Volt) scalar for BQ51_VRECT_STATUS_RAM and BQ51_VOUT_STATUS_RAM
-static const float BQ51_WATT_SCALAR = 0.039; // (Watt) scalar for BQ51_REC_PWR_STATUS_RAM and BQ51_FOD_RAM_RO_bits
+#define BQ51_VRECT_UVLO_raw        63 // (2.9V / 46mV) the UnderVoltage LockOut is max 2.9V, according to the TI BQ51222 datasheet. Below this, the 0xE0+ registers are reset
+
+#ifndef BQ51_noFloat
+  static const float BQ51_VOLT_SCALAR = 0.046; // (Volt) scalar for BQ51_VRECT_STATUS_RAM and BQ51_VOUT_STATUS_RAM
+  static const float BQ51_WATT_SCALAR = 0.039; // (Watt) scalar for BQ51_REC_PWR_STATUS_RAM and BQ51_FOD_RAM_RO_bits
+#endif
+//// integer scalars: the datasheet LSBs are whole milliVolts/milliWatts, so (raw * scalar) is exact (no rounding at all), and fits in a uint16_t (255*46 = 11730)
+static const uint8_t BQ51_VOLT_SCALAR_mV = 46; // (milliVolt) scalar for BQ51_VRECT_STATUS_RAM and BQ51_VOUT_STATUS_RAM
+static const uint8_t BQ51_WATT_SCALAR_mW = 39; // (milliWatt) scalar for BQ51_REC_PWR_STATUS_RAM and BQ51_FOD_RAM_RO_bits
 
 //// i could've made an enum for VO_REG, but the math is so nice and linear, it just feels like a waste
 
@@ -131,6 +144,86 @@ enum BQ51_RS_FOD_ENUM : uint8_t { // 3bit value to determine ESR multiplier(?) f
   BQ51_RS_FOD_05x = 7 // ESR*0.5
 };
 
+enum BQ51_CHIP_ENUM : uint8_t { // chip variant, see BQ51_thijs_variant
+  BQ51_CHIP_BQ5122x = 0, // BQ51222 or BQ51221 (has all registers)
+  BQ51_CHIP_BQ51021 = 1  // BQ51021 (no Mode Indicator register, and no RXID (according to the datasheet))
+};
+
+/**
+ * (private) the shift of a bit field, derived from its mask (the number of trailing 0 bits)
+ * @param mask field mask, like BQ51_FOD_RAM_RO_bits
+ * @return how far the field is shifted left in the register
+ */
+constexpr uint8_t _BQ51_maskShift(uint8_t mask) { return(((mask == 0) || (mask & 1)) ? 0 : (1 + _BQ51_maskShift(mask >> 1))); }
+
+/**
+ * one or more (encoded) field values in the same register, to be written in one go (see BQ51_thijs::setFields())
+ * combine them with |, like: BQ51_FOD_RO_field::with(3) | BQ51_FOD_RS_field::with(BQ51_RS_FOD_2x)
+ * (fields of different registers can't be combined, that's a compile error)
+ */
+template<uint8_t REG>
+struct BQ51_fieldWrite {
+  uint8_t value; // (already shifted and masked)
+  uint8_t mask;  // all bits that are written
+  constexpr BQ51_fieldWrite operator|(BQ51_fieldWrite other) const { return(BQ51_fieldWrite{(uint8_t)(value | other.value), (uint8_t)(mask | other.mask)}); }
+};
+
+/**
+ * a register bit field, entirely resolved at compile time (the shift is derived from the mask), so encode()/decode() are just a shift and an AND
+ */
+template<uint8_t REG, uint8_t MASK>
+struct BQ51_field {
+  static const uint8_t reg = REG;
+  static const uint8_t mask = MASK;
+  static const uint8_t shift = _BQ51_maskShift(MASK);
+  static_assert(MASK != 0, "a field needs at least 1 bit");
+  /**
+   * @param value field value (not shifted)
+   * @return the value, shifted into place in the register (and masked)
+   */
+  static constexpr uint8_t encode(uint8_t value) { return((uint8_t)(value << shift) & MASK); }
+  /**
+   * @param regValue the whole register value
+   * @return the field value (not shifted)
+   */
+  static constexpr uint8_t decode(uint8_t regValue) { return((regValue & MASK) >> shift); }
+  /**
+   * @param value field value (not shifted)
+   * @return the field value, ready to be passed to BQ51_thijs::setFields() (or combined with other fields in the same register)
+   */
+  static constexpr BQ51_fieldWrite<REG> with(uint8_t value) { return(BQ51_fieldWrite<REG>{encode(value), MASK}); }
+};
+
+//// field descriptors: (see the bits above)
+typedef BQ51_field<BQ51_VO_REG, BQ51_VO_REG_bits>                BQ51_VO_REG_field;
+typedef BQ51_field<BQ51_IO_REG, BQ51_IO_REG_bits>                BQ51_IO_REG_field;
+typedef BQ51_field<BQ51_MAILBOX, BQ51_MAILBOX_SEND_bits>         BQ51_MAILBOX_SEND_field;
+typedef BQ51_field<BQ51_MAILBOX, BQ51_MAILBOX_ERR_bits>          BQ51_MAILBOX_ERR_field;
+typedef BQ51_field<BQ51_MAILBOX, BQ51_MAILBOX_ALIGN_bits>        BQ51_MAILBOX_ALIGN_field;
+typedef BQ51_field<BQ51_FOD_RAM, BQ51_FOD_RAM_ESR_EN_bits>       BQ51_FOD_ESR_EN_field;
+typedef BQ51_field<BQ51_FOD_RAM, BQ51_FOD_RAM_OFF_EN_bits>       BQ51_FOD_OFF_EN_field;
+typedef BQ51_field<BQ51_FOD_RAM, BQ51_FOD_RAM_RO_bits>           BQ51_FOD_RO_field;
+typedef BQ51_field<BQ51_FOD_RAM, BQ51_FOD_RAM_RS_bits>           BQ51_FOD_RS_field;
+typedef BQ51_field<BQ51_MODE_IND, BQ51_MODE_IND_ALIGN_bits>      BQ51_MODE_IND_ALIGN_field;
+typedef BQ51_field<BQ51_MODE_IND, BQ51_MODE_IND_MODE_bits>       BQ51_MODE_IND_MODE_field;
+
+/**
+ * a (consistent) snapshot of the status registers, see readTelemetry()
+ */
+struct BQ51_telemetry {
+  uint8_t VRECT;      // raw BQ51_VRECT_STATUS_RAM value, LSB = 46mV
+  uint8_t VOUT;       // raw BQ51_VOUT_STATUS_RAM value, LSB = 46mV
+  uint8_t REC_PWR;    // raw BQ51_REC_PWR_STATUS_RAM value, LSB = 39mW
+  uint8_t MODE_IND;   // raw BQ51_MODE_IND value (only if it was requested, 0 otherwise)
+  uint16_t VRECT_mV;  // V_RECT in milliVolts (exact)
+  uint16_t VOUT_mV;   // V_OUT in milliVolts (exact)
+  uint16_t REC_PWR_mW; // received power in milliWatts (exact)
+  #ifndef BQ51_noFloat
+    float VRECT_volt;   // V_RECT in Volts
+    float VOUT_volt;    // V_OUT in Volts
+    float REC_PWR_watt; // received power in Watts
+  #endif
+};
 
 #include "_BQ51_thijs_base.h" // this file holds all the nitty-gritty low-level stuff (I2C implementations (platform optimizations))
 /**
@@ -155,6 +248,56 @@ class BQ51_thijs : public _BQ51_thijs_base
   - onlyReadBytes()
   - writeBytes()
   */
+
+  #if defined(BQ51_useInstrumentation) || defined(BQ51_useTrace) // these wrap the base functions, so every transaction (also from the add-ons) gets recorded
+    /**
+     * (instrumented) request a specific register and read bytes into a buffer, see _BQ51_thijs_base
+     * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote/read successfully
+     */
+    BQ51_ERR_RETURN_TYPE requestReadBytes(uint8_t registerToRead, uint8_t readBuff[], uint8_t bytesToRead) {
+      uint32_t start = BQ51_INSTR_CLOCK();
+      BQ51_ERR_RETURN_TYPE err = _BQ51_thijs_base::requestReadBytes(registerToRead, readBuff, bytesToRead);
+      _recordTransaction(start, BQ51_TRANSACTION_read, registerToRead, readBuff, bytesToRead, err);
+      return(err);
+    }
+    /**
+     * (instrumented) read bytes into a buffer (without first writing a register value!), see _BQ51_thijs_base
+     * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it read successfully
+     */
+    BQ51_ERR_RETURN_TYPE onlyReadBytes(uint8_t readBuff[], uint8_t bytesToRead) {
+      uint32_t start = BQ51_INSTR_CLOCK();
+      BQ51_ERR_RETURN_TYPE err = _BQ51_thijs_base::onlyReadBytes(readBuff, bytesToRead);
+      _recordTransaction(start, BQ51_TRANSACTION_onlyRead, 0, readBuff, bytesToRead, err);
+      return(err);
+    }
+    /**
+     * (instrumented) request a specific register and write bytes from a buffer, see _BQ51_thijs_base
+     * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
+     */
+    BQ51_ERR_RETURN_TYPE writeBytes(uint8_t registerToWrite, uint8_t writeBuff[], uint8_t bytesToWrite) {
+      uint32_t start = BQ51_INSTR_CLOCK();
+      BQ51_ERR_RETURN_TYPE err = _BQ51_thijs_base::writeBytes(registerToWrite, writeBuff, bytesToWrite);
+      _recordTransaction(start, BQ51_TRANSACTION_write, registerToWrite, writeBuff, bytesToWrite, err);
+      return(err);
+    }
+
+    /**
+     * (private) record a transaction in instrumentation and/or trace
+     */
+    void _recordTransaction(uint32_t start, uint8_t direction, uint8_t reg, const uint8_t data[], uint8_t length, BQ51_ERR_RETURN_TYPE err) {
+      uint32_t duration = BQ51_INSTR_CLOCK() - start;
+      bool good = _errGood(err);
+      #ifdef BQ51_useInstrumentation
+        instrumentation.record(direction == BQ51_TRANSACTION_write, (direction == BQ51_TRANSACTION_onlyRead) ? BQ51_INSTR_REG_onlyRead : BQ51_instrumentation::regIndex(reg), length, err, good, duration);
+      #endif
+      #ifdef BQ51_useTrace
+        trace.record(start, duration, direction, reg, data, length, err, good);
+      #else
+        (void)data;
+      #endif
+    }
+  #endif
+
   //// the following functions are abstract enough that they'll work for either architecture
 
   //private:
@@ -166,12 +309,133 @@ class BQ51_thijs : public _BQ51_thijs_base
    */
   BQ51_ERR_RETURN_TYPE _setBits(uint8_t registerToWrite, uint8_t newValue, uint8_t mask) {
     uint8_t temp;
-    requestReadBytes(registerToWrite, &temp, 1); // read the register
+    BQ51_ERR_RETURN_TYPE err = _cachedRead(registerToWrite, temp); // read the register (unless the shadow copy is valid)
+    if(!_errGood(err)) { return(err); } // don't write back garbage
     // if(registerToWrite == BQ51_MAILBOX) { temp |= BQ51_MAILBOX_SEND_bits; } // the 'send' bit will trigger a header transmission if a 0 is written to it. This prevents that
     if(registerToWrite == BQ51_MAILBOX) { temp &= (~BQ51_MAILBOX_FOD_S_bits); } // this bit must be kept 0, according to datasheet
     temp &= ~mask; //erase old value
     temp |= (newValue & mask); //insert new value
-    return(writeBytes(registerToWrite, &temp, 1)); // write the register
+    return(_cachedWrite(registerToWrite, temp)); // write the register
+  }
+
+  /**
+   * (private) write one or more fields of the same register in a single read-modify-write (see BQ51_fieldWrite)
+   * @param fields the (combined) field values, like: BQ51_FOD_RO_field::with(3) | BQ51_FOD_RS_field::with(BQ51_RS_FOD_2x)
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
+   */
+  template<uint8_t REG>
+  BQ51_ERR_RETURN_TYPE setFields(BQ51_fieldWrite<REG> fields) { return(_setBits(REG, fields.value, fields.mask)); }
+
+  /**
+   * (private) write a single field, like: setField<BQ51_FOD_RO_field>(3)
+   * @param newVal field value (not shifted)
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
+   */
+  template<class FIELD>
+  BQ51_ERR_RETURN_TYPE setField(uint8_t newVal) { return(_setBits(FIELD::reg, FIELD::encode(newVal), FIELD::mask)); }
+
+  /**
+   * (private) read a single field, like: getField<BQ51_FOD_RO_field>(value)
+   * (the MAILBOX SEND/ERR bits are always read from the device, the other writable registers may come from the shadow copy)
+   * @param readBuff byte reference to put the (unshifted) field value in
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it read successfully
+   */
+  template<class FIELD>
+  BQ51_ERR_RETURN_TYPE getField(uint8_t& readBuff) {
+    uint8_t temp = 0;
+    BQ51_ERR_RETURN_TYPE err;
+    if((FIELD::reg == BQ51_MAILBOX) && (FIELD::mask & (BQ51_MAILBOX_SEND_bits | BQ51_MAILBOX_ERR_bits))) { err = getMAILBOX(temp); } // (changed by the device itself)
+    else { err = _cachedRead(FIELD::reg, temp); }
+    readBuff = FIELD::decode(temp);
+    return(err);
+  }
+  /**
+   * (private) read a single field, like: getField<BQ51_FOD_RO_field>()
+   * @return the (unshifted) field value (0 if the read failed)
+   */
+  template<class FIELD>
+  uint8_t getField() { uint8_t retVal=0; getField<FIELD>(retVal); return(retVal); } // just a macro
+
+  #ifdef BQ51_useShadowCache
+    uint8_t _shadow[5]; // RAM copy of: VO_REG, IO_REG, MAILBOX, FOD_RAM, USER_HEADER_RAM
+    uint8_t _shadowValid = 0; // 1 bit per _shadow entry
+    static const uint8_t _shadowOutputRegs = 0b00011100; // MAILBOX, FOD_RAM and USER_HEADER_RAM are reset when V_RECT < V_UVLO
+  #endif
+
+  /**
+   * (private) find the index of a register in the shadow copy
+   * @param reg register byte (see list of defines at top)
+   * @return index in _shadow[], or 0xFF if the register is not shadowed
+   */
+  static uint8_t _shadowIndex(uint8_t reg) {
+    if((reg >= BQ51_VO_REG) && (reg <= BQ51_IO_REG)) { return(reg - BQ51_VO_REG); }
+    if((reg >= BQ51_MAILBOX) && (reg <= BQ51_USER_HEADER_RAM)) { return(2 + reg - BQ51_MAILBOX); }
+    return(0xFF);
+  }
+
+  /**
+   * (private) store a value in the shadow copy (does nothing if the cache is disabled or the register is not shadowed)
+   * @param reg register byte (see list of defines at top)
+   * @param value the value the register (now) holds
+   */
+  void _shadowStore(uint8_t reg, uint8_t value) {
+    #ifdef BQ51_useShadowCache
+      uint8_t index = _shadowIndex(reg);
+      if(index == 0xFF) { return; }
+      if(reg == BQ51_MAILBOX) { // the SEND and ERR bits are changed by the device itself, so only the 'idle' state of those is stored
+        value |= BQ51_MAILBOX_SEND_bits; // (if a send was just triggered, the device will set this bit once it's done. Storing 1 also ensures a RMW never re-triggers a send)
+        value &= ~(BQ51_MAILBOX_ERR_bits | BQ51_MAILBOX_FOD_S_bits);
+      }
+      _shadow[index] = value;
+      _shadowValid |= (1 << index);
+    #else
+      (void)reg; (void)value;
+    #endif
+  }
+
+  /**
+   * (private) get a register from the shadow copy, without touching the bus
+   * @param reg register byte (see list of defines at top)
+   * @param readBuff byte reference to put the result in (only if the shadow copy was valid)
+   * @return whether the shadow copy of that register was valid (always false if BQ51_useShadowCache is not defined)
+   */
+  bool _shadowGet(uint8_t reg, uint8_t& readBuff) {
+    #ifdef BQ51_useShadowCache
+      uint8_t index = _shadowIndex(reg);
+      if((index != 0xFF) && (_shadowValid & (1 << index))) { readBuff = _shadow[index]; return(true); }
+    #else
+      (void)reg; (void)readBuff;
+    #endif
+    return(false);
+  }
+
+  /**
+   * (private) read a (single) register, from the shadow copy if possible
+   * @param reg register byte (see list of defines at top)
+   * @param readBuff byte reference to put the result in
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it read successfully
+   */
+  BQ51_ERR_RETURN_TYPE _cachedRead(uint8_t reg, uint8_t& readBuff) {
+    #ifdef BQ51_useShadowCache
+      uint8_t index = _shadowIndex(reg);
+      if((index != 0xFF) && (_shadowValid & (1 << index))) { readBuff = _shadow[index]; shadowHits++; return(BQ51_ERR_GOOD); }
+      if(index != 0xFF) { shadowMisses++; }
+    #endif
+    BQ51_ERR_RETURN_TYPE err = requestReadBytes(reg, &readBuff, 1);
+    if(_errGood(err)) { _shadowStore(reg, readBuff); }
+    return(err);
+  }
+
+  /**
+   * (private) write a (single) register, and keep the shadow copy up to date
+   * @param reg register byte (see list of defines at top)
+   * @param newVal the value to write
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
+   */
+  BQ51_ERR_RETURN_TYPE _cachedWrite(uint8_t reg, uint8_t newVal) {
+    BQ51_ERR_RETURN_TYPE err = writeBytes(reg, &newVal, 1);
+    if(_errGood(err)) { _shadowStore(reg, newVal); } else { shadowInvalidate(); } // if the write failed, the device contents are unknown
+    return(err);
   }
 
   public:
@@ -186,11 +450,31 @@ class BQ51_thijs : public _BQ51_thijs_base
       return(err == ESP_OK);
     #elif defined(BQ51_return_i2c_status_e)
       return(err == I2C_OK);
+    #elif defined(BQ51_return_errno)
+      return(err == 0);
     #else
       return(err);
     #endif
   }
 
+  #ifdef BQ51_useShadowCache
+    uint32_t shadowHits = 0;   // number of register reads served from the shadow copy (== bus transactions saved)
+    uint32_t shadowMisses = 0; // number of (shadowed) register reads that still had to go over the bus
+  #endif
+
+  /**
+   * forget the shadow copy of the registers, so the next access reads them from the device again (does nothing if BQ51_useShadowCache is not defined)
+   * called automatically when V_RECT is found to be below V_UVLO (by getVRECT() or poweredCheck()), call it manually if you suspect the device was reset in between
+   * @param onlyOutputRegs if true, only forget the registers that reset when V_RECT < V_UVLO (MAILBOX, FOD_RAM and USER_HEADER_RAM)
+   */
+  void shadowInvalidate(bool onlyOutputRegs=false) {
+    #ifdef BQ51_useShadowCache
+      _shadowValid &= onlyOutputRegs ? (~_shadowOutputRegs) : 0;
+    #else
+      (void)onlyOutputRegs;
+    #endif
+  }
+
   ////////////////////////////////////////// set functions: ////////////////////////////////////////////////////
   
   /**
@@ -198,69 +482,69 @@ class BQ51_thijs : public _BQ51_thijs_base
    * @param newVal 3 LSBits set VO_REG target from 450~800mV, VO_REG = 450+(bits*50) mV
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  BQ51_ERR_RETURN_TYPE setVO_REG(uint8_t newVal) { newVal &= BQ51_VO_REG_bits; return(writeBytes(BQ51_VO_REG, &newVal, 1)); }
+  BQ51_ERR_RETURN_TYPE setVO_REG(uint8_t newVal) { return(_cachedWrite(BQ51_VO_REG, BQ51_VO_REG_field::encode(newVal))); }
   /**
    * set the IO_REG target (Supply Current Register 2) bits directly
    * @param newVal 3 LSBits set I_ILIM current, 10,20,30,40,50,60, 90, 100 % ,see BQ51_ILIM_ENUM
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  BQ51_ERR_RETURN_TYPE setIO_REG(BQ51_ILIM_ENUM newVal) { uint8_t temp=static_cast<uint8_t>(newVal)&BQ51_IO_REG_bits; return(writeBytes(BQ51_IO_REG, &temp, 1)); }
+  BQ51_ERR_RETURN_TYPE setIO_REG(BQ51_ILIM_ENUM newVal) { return(_cachedWrite(BQ51_IO_REG, BQ51_IO_REG_field::encode(newVal))); }
 
   /**
    * set the (whole) MAILBOX register (Note: writing 0 to first bit triggers custom header transmission, and 6th bit must be 0)
    * @param newVal I2C Mailbox Register (involved in Qi packet transfer stuff)
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  BQ51_ERR_RETURN_TYPE setMAILBOX(uint8_t newVal) { return(writeBytes(BQ51_MAILBOX, &newVal, 1)); }
+  BQ51_ERR_RETURN_TYPE setMAILBOX(uint8_t newVal) { return(_cachedWrite(BQ51_MAILBOX, newVal)); }
   /**
    * set USER_PKT_DONE to 0, which will send a packet with header in BQ51_USER_HEADER_RAM, and will read as 1 when packet has been sent
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  BQ51_ERR_RETURN_TYPE setMAILBOX_SEND() { return(_setBits(BQ51_MAILBOX, 0, BQ51_MAILBOX_SEND_bits)); }
+  BQ51_ERR_RETURN_TYPE setMAILBOX_SEND() { return(setField<BQ51_MAILBOX_SEND_field>(0)); }
   /**
    * set the ALIGN Mailer bit in the MAILBOX register
    * @param newVal ALIGN Mailer will "enable alignment aid mode where the CEP = 0" (i think only PMA has an alignment mode???)
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  BQ51_ERR_RETURN_TYPE setMAILBOX_ALIGN(bool newVal) { return(_setBits(BQ51_MAILBOX, newVal ? BQ51_MAILBOX_ALIGN_bits : 0, BQ51_MAILBOX_ALIGN_bits)); }
+  BQ51_ERR_RETURN_TYPE setMAILBOX_ALIGN(bool newVal) { return(setField<BQ51_MAILBOX_ALIGN_field>(newVal)); }
 
   /**
    * set the (whole) FOD RAM register
    * @param newVal Wireless Power Supply FOD RAM Register (involved in Foreign Object Detection)
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  BQ51_ERR_RETURN_TYPE setFOD_RAM(uint8_t newVal) { return(writeBytes(BQ51_FOD_RAM, &newVal, 1)); }
+  BQ51_ERR_RETURN_TYPE setFOD_RAM(uint8_t newVal) { return(_cachedWrite(BQ51_FOD_RAM, newVal)); }
   /**
    * set the ESR_ENABLE bit in the FOD RAM register
    * @param newVal ESR_ENABLE enables I2C based ESR in received power. 1=enable, 0=disable
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  BQ51_ERR_RETURN_TYPE setFOD_ESR_EN(bool newVal) { return(_setBits(BQ51_FOD_RAM, newVal ? BQ51_FOD_RAM_ESR_EN_bits : 0, BQ51_FOD_RAM_ESR_EN_bits)); }
+  BQ51_ERR_RETURN_TYPE setFOD_ESR_EN(bool newVal) { return(setField<BQ51_FOD_ESR_EN_field>(newVal)); }
   /**
    * set the OFF_ENABLE bit in the FOD RAM register
    * @param newVal OFF_ENABLE enables I2C based offset power. 1=enable, 0=disable
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  BQ51_ERR_RETURN_TYPE setFOD_OFF_EN(bool newVal) { return(_setBits(BQ51_FOD_RAM, newVal ? BQ51_FOD_RAM_OFF_EN_bits : 0, BQ51_FOD_RAM_OFF_EN_bits)); }
+  BQ51_ERR_RETURN_TYPE setFOD_OFF_EN(bool newVal) { return(setField<BQ51_FOD_OFF_EN_field>(newVal)); }
   /**
    * set the RO_FODx bits (3) in the FOD RAM register
    * @param newVal RO_FODx bits for setting the offset power. 3bit value, LSB = 39mW, value is added to received power message
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  BQ51_ERR_RETURN_TYPE setFOD_RO(uint8_t newVal) { return(_setBits(BQ51_FOD_RAM, newVal << 3, BQ51_FOD_RAM_RO_bits)); }
+  BQ51_ERR_RETURN_TYPE setFOD_RO(uint8_t newVal) { return(setField<BQ51_FOD_RO_field>(newVal)); }
   /**
    * set the RS_FODx bits (3) in the FOD RAM register (see BQ51_RS_FOD_ENUM for options)
    * @param newVal RS_FODx bits for setting ESR multiplier(?). 3bit value, 0=1=5=6=ESR, 2=ESR*2, 3=ESR*3, 4=ESR*4, 7=ESR*0.5
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  BQ51_ERR_RETURN_TYPE setFOD_RS(BQ51_RS_FOD_ENUM newVal) { return(_setBits(BQ51_FOD_RAM, static_cast<uint8_t>(newVal), BQ51_FOD_RAM_RS_bits)); }
+  BQ51_ERR_RETURN_TYPE setFOD_RS(BQ51_RS_FOD_ENUM newVal) { return(setField<BQ51_FOD_RS_field>(newVal)); }
 
   /**
    * set the User Header RAM register
    * @param newVal Wireless Power User Header RAM Register (for custom Qi packets(?))
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  BQ51_ERR_RETURN_TYPE setUSER_HEADER(uint8_t newVal) { return(writeBytes(BQ51_USER_HEADER_RAM, &newVal, 1)); }
+  BQ51_ERR_RETURN_TYPE setUSER_HEADER(uint8_t newVal) { return(_cachedWrite(BQ51_USER_HEADER_RAM, newVal)); }
 
   /**
    * set the Prop Packet Payload RAM Byte registers (all 4)
@@ -295,7 +579,7 @@ class BQ51_thijs : public _BQ51_thijs_base
    * @param readBuff byte reference to put the result in
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote/read successfully
    */
-  BQ51_ERR_RETURN_TYPE getVO_REG(uint8_t& readBuff) { return(requestReadBytes(BQ51_VO_REG, &readBuff, 1)); }
+  BQ51_ERR_RETURN_TYPE getVO_REG(uint8_t& readBuff) { return(_cachedRead(BQ51_VO_REG, readBuff)); }
   /**
    * retrieve VO_REG (Supply Current Register 1) bits
    * @return 3 LSBits set VO_REG target from 450~800mV, VO_REG = 450+(bits*50) mV
@@ -305,13 +589,20 @@ class BQ51_thijs : public _BQ51_thijs_base
    * retrieve VO_REG (Supply Current Register 1) in milliVolts (float)
    * @return VO_REG target in milliVolts, from 450~800mV, VO_REG = 450+(bits*50) mV
    */
-  float getVO_REG_volt() { return(0.450 + (getVO_REG()*0.050)); } // just a macro
+  #ifndef BQ51_noFloat
+    float getVO_REG_volt() { return(0.450 + (getVO_REG()*0.050)); } // just a macro
+  #endif
+  /**
+   * retrieve VO_REG (Supply Current Register 1) in milliVolts (integer, exact)
+   * @return VO_REG target in milliVolts, from 450~800mV, VO_REG = 450+(bits*50) mV
+   */
+  uint16_t getVO_REG_mV() { return(450 + (getVO_REG()*50)); } // just a macro
   /**
    * retrieve IO_REG (Supply Current Register 2) bits
    * @param readBuff enum (byte) reference to put the result in
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote/read successfully
    */
-  BQ51_ERR_RETURN_TYPE getIO_REG(BQ51_ILIM_ENUM& readBuff) { return(requestReadBytes(BQ51_IO_REG, (uint8_t*)&readBuff, 1)); }
+  BQ51_ERR_RETURN_TYPE getIO_REG(BQ51_ILIM_ENUM& readBuff) { return(_cachedRead(BQ51_IO_REG, (uint8_t&)readBuff)); }
   /**
    * retrieve IO_REG (Supply Current Register 2) bits
    * @return 3 LSBits set I_ILIM current, 10,20,30,40,50,60, 90, 100 % (breaks pattern for for 0b_110 and 0b_111)
@@ -324,11 +615,15 @@ class BQ51_thijs : public _BQ51_thijs_base
   uint8_t getIO_REG_percent() { uint8_t IO_REG_bits=getIO_REG(); return((IO_REG_bits==7) ? 100 : ((IO_REG_bits==6) ? 90 : (10*(IO_REG_bits+1)))); } // just a macro
 
   /**
-   * retrieve the (whole) MAILBOX register
+   * retrieve the (whole) MAILBOX register (always read from the device, as the SEND and ERR bits are changed by the device itself)
    * @param readBuff byte reference to put the result in
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote/read successfully
    */
-  BQ51_ERR_RETURN_TYPE getMAILBOX(uint8_t& readBuff) { return(requestReadBytes(BQ51_MAILBOX, &readBuff, 1)); }
+  BQ51_ERR_RETURN_TYPE getMAILBOX(uint8_t& readBuff) {
+    BQ51_ERR_RETURN_TYPE err = requestReadBytes(BQ51_MAILBOX, &readBuff, 1);
+    if(_errGood(err)) { _shadowStore(BQ51_MAILBOX, readBuff); }
+    return(err);
+  }
   /**
    * retrieve (whole) MAILBOX register
    * @return I2C Mailbox Register (involved in Qi packet transfer stuff)
@@ -338,24 +633,24 @@ class BQ51_thijs : public _BQ51_thijs_base
    * retrieve USER_PKT_DONE, which will read as 1 when packet has been sent
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  bool getMAILBOX_SEND() { return((getMAILBOX() & BQ51_MAILBOX_SEND_bits) != 0); }
+  bool getMAILBOX_SEND() { return(getField<BQ51_MAILBOX_SEND_field>() != 0); }
   /**
    * retrieve the USER_PKT_ERR bits from the MAILBOX register (see BQ51_MAILBOX_ERR_ENUM)
    * @return USER_PKT_ERR bits indicate errors with packet sending: 0=no_err, 1=no_TX, 2=bad_header, 3=err_TBD
    */
-  BQ51_MAILBOX_ERR_ENUM getMAILBOX_ERR() { return(static_cast<BQ51_MAILBOX_ERR_ENUM>((getMAILBOX() & BQ51_MAILBOX_ERR_bits)>>5)); }
+  BQ51_MAILBOX_ERR_ENUM getMAILBOX_ERR() { return(static_cast<BQ51_MAILBOX_ERR_ENUM>(getField<BQ51_MAILBOX_ERR_field>())); }
   /**
    * retrieve the ALIGN Mailer bit from the MAILBOX register
    * @return ALIGN Mailer will "enable alignment aid mode where the CEP = 0" (i think only PMA has an alignment mode???)
    */
-  bool getMAILBOX_ALIGN() { return((getMAILBOX() & BQ51_MAILBOX_ALIGN_bits) != 0); }
+  bool getMAILBOX_ALIGN() { return(getField<BQ51_MAILBOX_ALIGN_field>() != 0); }
 
   /**
    * retrieve the (whole) FOD RAM register
    * @param readBuff byte reference to put the result in
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote/read successfully
    */
-  BQ51_ERR_RETURN_TYPE getFOD_RAM(uint8_t& readBuff) { return(requestReadBytes(BQ51_FOD_RAM, &readBuff, 1)); }
+  BQ51_ERR_RETURN_TYPE getFOD_RAM(uint8_t& readBuff) { return(_cachedRead(BQ51_FOD_RAM, readBuff)); }
   /**
    * retrieve the (whole) FOD RAM register
    * @return Wireless Power Supply FOD RAM Register (involved in Foreign Object Detection)
@@ -365,39 +660,59 @@ class BQ51_thijs : public _BQ51_thijs_base
    * retrieve the getFOD_ESR_EN bit from the FOD RAM register
    * @return ESR_ENABLE enables I2C based ESR in received power. 1=enable, 0=disable
    */
-  bool getFOD_ESR_EN() { return((getFOD_RAM() & BQ51_FOD_RAM_ESR_EN_bits) != 0); }
+  bool getFOD_ESR_EN() { return(getField<BQ51_FOD_ESR_EN_field>() != 0); }
   /**
    * retrieve the getFOD_OFF_EN bit from the FOD RAM register
    * @return OFF_ENABLE enables I2C based offset power. 1=enable, 0=disable
    */
-  bool getFOD_OFF_EN() { return((getFOD_RAM() & BQ51_FOD_RAM_OFF_EN_bits) != 0); }
+  bool getFOD_OFF_EN() { return(getField<BQ51_FOD_OFF_EN_field>() != 0); }
   /**
    * retrieve the getFOD_RO bits from the FOD RAM register (see BQ51_RS_FOD_ENUM)
    * @return RO_FODx bits for setting the offset power. 3bit value, LSB = 39mW, value is added to received power message
    */
-  uint8_t getFOD_RO() { return((getFOD_RAM() & BQ51_FOD_RAM_RO_bits)>>3); }
+  uint8_t getFOD_RO() { return(getField<BQ51_FOD_RO_field>()); }
   /**
    * retrieve the getFOD_RO in milliWatts from the FOD RAM register (see BQ51_RS_FOD_ENUM)
    * @return RO_FODx in milliWatts for setting the offset power. 3bit value, LSB = 39mW, value is added to received power message
    */
-  float getFOD_RO_mW() { return(getFOD_RO() * BQ51_WATT_SCALAR); }
+  #ifndef BQ51_noFloat
+    float getFOD_RO_mW() { return(getFOD_RO() * BQ51_WATT_SCALAR); }
+  #endif
+  /**
+   * retrieve the getFOD_RO in milliWatts (integer, exact) from the FOD RAM register
+   * @return RO_FODx in milliWatts for setting the offset power. 3bit value, LSB = 39mW, value is added to received power message
+   */
+  uint16_t getFOD_RO_mW_int() { return(getFOD_RO() * BQ51_WATT_SCALAR_mW); }
   /**
    * retrieve the RS_FODx bits from the FOD RAM register (see BQ51_RS_FOD_ENUM)
    * @return RS_FODx bits for setting ESR multiplier(?). 3bit value, 0=1=5=6=ESR, 2=ESR*2, 3=ESR*3, 4=ESR*4, 7=ESR*0.5
    */
-  BQ51_RS_FOD_ENUM getFOD_RS() { return(static_cast<BQ51_RS_FOD_ENUM>(getFOD_RAM() & BQ51_FOD_RAM_RS_bits)); }
+  BQ51_RS_FOD_ENUM getFOD_RS() { return(static_cast<BQ51_RS_FOD_ENUM>(getField<BQ51_FOD_RS_field>())); }
   /**
    * retrieve the RS_FODx as a float (multiplier) from the FOD RAM register
    * @return ESR multiplier(?) calculated from: RS_FODx bits for setting ESR multiplier(?). 3bit value, 0=1=5=6=ESR, 2=ESR*2, 3=ESR*3, 4=ESR*4, 7=ESR*0.5
    */
-  float getFOD_RS_mult() { uint8_t FOD_RS_bits=getFOD_RS(); return((FOD_RS_bits==0) ? 1 : ((FOD_RS_bits<5) ? FOD_RS_bits : ((FOD_RS_bits==7) ? 0.5 : 1))); }
+  #ifndef BQ51_noFloat
+    float getFOD_RS_mult() { uint8_t FOD_RS_bits=getFOD_RS(); return((FOD_RS_bits==0) ? 1 : ((FOD_RS_bits<5) ? FOD_RS_bits : ((FOD_RS_bits==7) ? 0.5 : 1))); }
+  #endif
+  /**
+   * convert RS_FODx bits to an ESR multiplier in per-mille (integer, exact)
+   * @param FOD_RS_bits RS_FODx bits (see BQ51_RS_FOD_ENUM)
+   * @return ESR multiplier * 1000, so 1000=ESR, 2000=ESR*2, 3000=ESR*3, 4000=ESR*4, 500=ESR*0.5
+   */
+  static uint16_t FOD_RS_permille(uint8_t FOD_RS_bits) { return(((FOD_RS_bits>=2) && (FOD_RS_bits<=4)) ? (FOD_RS_bits*1000) : ((FOD_RS_bits==7) ? 500 : 1000)); }
+  /**
+   * retrieve the RS_FODx as an (integer) multiplier in per-mille from the FOD RAM register
+   * @return ESR multiplier * 1000, so 1000=ESR, 2000=ESR*2, 3000=ESR*3, 4000=ESR*4, 500=ESR*0.5
+   */
+  uint16_t getFOD_RS_permille() { return(FOD_RS_permille(getFOD_RS())); }
 
   /**
    * retrieve the User Header RAM register
    * @param readBuff byte reference to put the result in
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote/read successfully
    */
-  BQ51_ERR_RETURN_TYPE getUSER_HEADER(uint8_t& readBuff) { return(requestReadBytes(BQ51_USER_HEADER_RAM, &readBuff, 1)); }
+  BQ51_ERR_RETURN_TYPE getUSER_HEADER(uint8_t& readBuff) { return(_cachedRead(BQ51_USER_HEADER_RAM, readBuff)); }
   /**
    * retrieve the User Header RAM register
    * @return Wireless Power User Header RAM Register (for custom Qi packets(?))
@@ -405,11 +720,15 @@ class BQ51_thijs : public _BQ51_thijs_base
   uint8_t getUSER_HEADER() { uint8_t retVal=0; getUSER_HEADER(retVal); return(retVal); } // just a macro
   
   /**
-   * retrieve the USER V_RECT Status RAM register
+   * retrieve the USER V_RECT Status RAM register (if V_RECT < V_UVLO, the shadow copy of the output registers is invalidated)
    * @param readBuff byte reference to put the result in
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote/read successfully
    */
-  BQ51_ERR_RETURN_TYPE getVRECT(uint8_t& readBuff) { return(requestReadBytes(BQ51_VRECT_STATUS_RAM, &readBuff, 1)); }
+  BQ51_ERR_RETURN_TYPE getVRECT(uint8_t& readBuff) {
+    BQ51_ERR_RETURN_TYPE err = requestReadBytes(BQ51_VRECT_STATUS_RAM, &readBuff, 1);
+    if(_errGood(err) && (readBuff < BQ51_VRECT_UVLO_raw)) { shadowInvalidate(true); } // the 0xE0+ registers are reset (or will be soon)
+    return(err);
+  }
   /**
    * retrieve the USER V_RECT Status RAM register
    * @return Wireless Power USER V_RECT Status RAM Register (reads back V_RECT voltage, LSB = 46mV)
@@ -419,7 +738,14 @@ class BQ51_thijs : public _BQ51_thijs_base
    * retrieve the USER V_RECT Status RAM register in volts (float)
    * @return Wireless Power USER V_RECT Status RAM Register (reads back V_RECT voltage, LSB = 46mV)
    */
-  float getVRECT_volt() { return(getVRECT() * BQ51_VOLT_SCALAR); } // just a macro
+  #ifndef BQ51_noFloat
+    float getVRECT_volt() { return(getVRECT() * BQ51_VOLT_SCALAR); } // just a macro
+  #endif
+  /**
+   * retrieve the USER V_RECT Status RAM register in milliVolts (integer, exact)
+   * @return Wireless Power USER V_RECT Status RAM Register (reads back V_RECT voltage, LSB = 46mV)
+   */
+  uint16_t getVRECT_mV() { return(getVRECT() * BQ51_VOLT_SCALAR_mV); } // just a macro
   /**
    * retrieve the VO_OUT Status RAM register
    * @param readBuff byte reference to put the result in
@@ -435,7 +761,14 @@ class BQ51_thijs : public _BQ51_thijs_base
    * retrieve the VO_OUT Status RAM register in volts (float)
    * @return Wireless Power VO_OUT Status RAM Register (reads back V_OUT voltage, LSB = 46mV)
    */
-  float getVOUT_volt() { return(getVOUT() * BQ51_VOLT_SCALAR); } // just a macro
+  #ifndef BQ51_noFloat
+    float getVOUT_volt() { return(getVOUT() * BQ51_VOLT_SCALAR); } // just a macro
+  #endif
+  /**
+   * retrieve the VO_OUT Status RAM register in milliVolts (integer, exact)
+   * @return Wireless Power VO_OUT Status RAM Register (reads back V_OUT voltage, LSB = 46mV)
+   */
+  uint16_t getVOUT_mV() { return(getVOUT() * BQ51_VOLT_SCALAR_mV); } // just a macro
   /**
    * retrieve the REC PWR Byte Status RAM register
    * @param readBuff byte reference to put the result in
@@ -451,8 +784,59 @@ class BQ51_thijs : public _BQ51_thijs_base
    * retrieve the REC PWR Byte Status RAM register in watts (float)
    * @return Wireless Power REC PWR Byte Status RAM Register (reads back received power, LSB = 39mW)
    */
-  float getREC_PWR_watt() { return(getREC_PWR() * BQ51_WATT_SCALAR); } // just a macro
+  #ifndef BQ51_noFloat
+    float getREC_PWR_watt() { return(getREC_PWR() * BQ51_WATT_SCALAR); } // just a macro
+  #endif
+  /**
+   * retrieve the REC PWR Byte Status RAM register in milliWatts (integer, exact)
+   * @return Wireless Power REC PWR Byte Status RAM Register (reads back received power, LSB = 39mW)
+   */
+  uint16_t getREC_PWR_mW() { return(getREC_PWR() * BQ51_WATT_SCALAR_mW); } // just a macro
   
+  /**
+   * retrieve V_RECT, V_OUT and REC_PWR (and optionally MODE_IND) in a single (burst) read, instead of 3 or 4 seperate ones
+   * (if V_RECT < V_UVLO, the shadow copy of the output registers is invalidated)
+   * @param readBuff BQ51_telemetry struct reference to put the (raw and scaled) results in
+   * @param includeMODE_IND whether to extend the read up to the Mode Indicator register (13 bytes instead of 6) (ignored on BQ51021)
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote/read successfully
+   */
+  BQ51_ERR_RETURN_TYPE readTelemetry(BQ51_telemetry& readBuff, bool includeMODE_IND=false) {
+    if(includeMODE_IND && isBQ51021) { BQ51debugPrint("BQ51021 doesn't have a Mode Indicator register!"); includeMODE_IND = false; }
+    return(_readTelemetry(readBuff, includeMODE_IND));
+  }
+  /**
+   * (private) readTelemetry() without the BQ51021 check (see BQ51_thijs_variant)
+   */
+  BQ51_ERR_RETURN_TYPE _readTelemetry(BQ51_telemetry& readBuff, bool includeMODE_IND) {
+    uint8_t rawBuff[BQ51_MODE_IND - BQ51_VRECT_STATUS_RAM + 1]; // 0xE3 ~ 0xEF (the registers are contiguous, so the device auto-increments)
+    uint8_t bytesToRead = includeMODE_IND ? sizeof(rawBuff) : (BQ51_REC_PWR_STATUS_RAM - BQ51_VRECT_STATUS_RAM + 1);
+    BQ51_ERR_RETURN_TYPE err = requestReadBytes(BQ51_VRECT_STATUS_RAM, rawBuff, bytesToRead);
+    if(!_errGood(err)) { return(err); }
+    _parseTelemetry(readBuff, rawBuff, includeMODE_IND);
+    if(readBuff.VRECT < BQ51_VRECT_UVLO_raw) { shadowInvalidate(true); } // the 0xE0+ registers are reset (or will be soon)
+    return(err);
+  }
+  /**
+   * (private) fill in a BQ51_telemetry struct from the raw register values (for add-ons that read the status registers as part of a larger burst)
+   * @param readBuff BQ51_telemetry struct reference to put the (raw and scaled) results in
+   * @param rawBuff the values of 0xE3 ~ 0xE5 (or 0xE3 ~ 0xEF if includeMODE_IND)
+   * @param includeMODE_IND whether rawBuff extends up to the Mode Indicator register
+   */
+  static void _parseTelemetry(BQ51_telemetry& readBuff, const uint8_t rawBuff[], bool includeMODE_IND) {
+    readBuff.VRECT = rawBuff[0];
+    readBuff.VOUT = rawBuff[BQ51_VOUT_STATUS_RAM - BQ51_VRECT_STATUS_RAM];
+    readBuff.REC_PWR = rawBuff[BQ51_REC_PWR_STATUS_RAM - BQ51_VRECT_STATUS_RAM];
+    readBuff.MODE_IND = includeMODE_IND ? rawBuff[BQ51_MODE_IND - BQ51_VRECT_STATUS_RAM] : 0;
+    readBuff.VRECT_mV = readBuff.VRECT * BQ51_VOLT_SCALAR_mV;
+    readBuff.VOUT_mV = readBuff.VOUT * BQ51_VOLT_SCALAR_mV;
+    readBuff.REC_PWR_mW = readBuff.REC_PWR * BQ51_WATT_SCALAR_mW;
+    #ifndef BQ51_noFloat
+      readBuff.VRECT_volt = readBuff.VRECT * BQ51_VOLT_SCALAR;
+      readBuff.VOUT_volt = readBuff.VOUT * BQ51_VOLT_SCALAR;
+      readBuff.REC_PWR_watt = readBuff.REC_PWR * BQ51_WATT_SCALAR;
+    #endif
+  }
+
   /**
    * retrieve the (whole) Mode Indicator register (not on BQ51021)
    * @param readBuff byte reference to put the result in
@@ -476,7 +860,7 @@ class BQ51_thijs : public _BQ51_thijs_base
    */
   bool getMODE_IND_ALIGN() {
     if(isBQ51021) { BQ51debugPrint("BQ51021 doesn't have a Mode Indicator register!"); return(0); }
-    return((getMODE_IND() & BQ51_MODE_IND_ALIGN_bits) != 0);
+    return(BQ51_MODE_IND_ALIGN_field::decode(getMODE_IND()) != 0);
   }
   /**
    * retrieve the Mode bit from the Mode Indicator register (not on BQ51021)
@@ -484,7 +868,7 @@ class BQ51_thijs : public _BQ51_thijs_base
    */
   bool getMODE() {
     if(isBQ51021) { BQ51debugPrint("BQ51021 doesn't have a Mode Indicator register!"); return(0); } // NOTE: returns WPC(Qi), which is correct
-    return((getMODE_IND() & BQ51_MODE_IND_MODE_bits) != 0);
+    return(BQ51_MODE_IND_MODE_field::decode(getMODE_IND()) != 0);
   }
   
   /**
@@ -523,21 +907,28 @@ class BQ51_thijs : public _BQ51_thijs_base
 
   /**
    * Attempts to check whether RXID is all 1's, to see if those registers are active. This also checks whether V_RECT > V_UVLO (which should mean a TX is providing power)
-   * @return V_RECT as a float, because why not (but use getV_RECT() for a much faster version)
+   * @return V_RECT in milliVolts (integer, exact), or -1 if not powered, or -2 if the I2C interaction failed
    */
-  float poweredCheck() {
+  int16_t poweredCheck_mV() {
     uint8_t readBuff[BQ51_RXID_size]; // sized for the RXID, but also used to hold V_RECT byte
     BQ51_ERR_RETURN_TYPE err = requestReadBytes(BQ51_RXID_READBACK, readBuff, BQ51_RXID_size);
-    if(!_errGood(err)) { return(-2.0); } // if the I2C interaction failed, the device may not even be connected.
+    if(!_errGood(err)) { return(-2); } // if the I2C interaction failed, the device may not even be connected.
     bool allOnes = true; for(uint8_t i=0; i<BQ51_RXID_size; i++) { allOnes &= (readBuff[i] == 0xFF); } // if any of the bytes is not all 1's, set the bool to false
-    if(allOnes) { return(-1.0); } // if the RXID read as all 1's, then those registers are likely reset/unpowered, because V_RECT < V_UVLO
-    err = requestReadBytes(BQ51_VRECT_STATUS_RAM, readBuff, 1);
-    if(!_errGood(err)) { return(-2.0); } // there is no good reason for the I2C interaction to fail on the second read, but might as well check
-    const static uint8_t UVLO = 2.9 / BQ51_VOLT_SCALAR; // the UnderVoltage LockOut is max 2.9V, according to the TI BQ51222 datasheet
-    if(readBuff[0] < UVLO) { return(-1.0); } // if the rectifier voltage read is below UVLO, it should not be on
-    return(readBuff[0] * BQ51_VOLT_SCALAR);
+    if(allOnes) { shadowInvalidate(true); return(-1); } // if the RXID read as all 1's, then those registers are likely reset/unpowered, because V_RECT < V_UVLO
+    err = getVRECT(readBuff[0]); // (also invalidates the shadow copy if V_RECT < V_UVLO)
+    if(!_errGood(err)) { return(-2); } // there is no good reason for the I2C interaction to fail on the second read, but might as well check
+    if(readBuff[0] < BQ51_VRECT_UVLO_raw) { return(-1); } // if the rectifier voltage read is below UVLO, it should not be on
+    return(readBuff[0] * BQ51_VOLT_SCALAR_mV);
   }
 
+  #ifndef BQ51_noFloat
+    /**
+     * Attempts to check whether RXID is all 1's, to see if those registers are active. This also checks whether V_RECT > V_UVLO (which should mean a TX is providing power)
+     * @return V_RECT as a float, because why not (but use getV_RECT() for a much faster version), or -1.0 if not powered, or -2.0 if the I2C interaction failed
+     */
+    float poweredCheck() { int16_t V_RECT_mV = poweredCheck_mV(); return((V_RECT_mV < 0) ? V_RECT_mV : (V_RECT_mV * 0.001)); }
+  #endif
+
   // /**
   //  * print out all the configuration values (just for debugging)
   //  * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
@@ -558,27 +949,110 @@ class BQ51_thijs : public _BQ51_thijs_base
    * write the defualt value to VO_REG (resetting the output voltage target to the one set by the resistors)
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  BQ51_ERR_RETURN_TYPE resetVO_REG() { static uint8_t VO_def=BQ51_VO_REG_default; return(writeBytes(BQ51_VO_REG, &VO_def, 1)); } // write the default value (according to datasheet) to VO_REG register
+  BQ51_ERR_RETURN_TYPE resetVO_REG() { return(_cachedWrite(BQ51_VO_REG, BQ51_VO_REG_default)); } // write the default value (according to datasheet) to VO_REG register
   /**
    * write the defualt value to IO_REG (resetting the I_ILIM current limit to 100% of the value set by the resistors)
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  BQ51_ERR_RETURN_TYPE resetIO_REG() { static uint8_t IO_def=BQ51_IO_REG_default; return(writeBytes(BQ51_IO_REG, &IO_def, 1)); } // write the default value (according to datasheet) to IO_REG register
+  BQ51_ERR_RETURN_TYPE resetIO_REG() { return(_cachedWrite(BQ51_IO_REG, BQ51_IO_REG_default)); } // write the default value (according to datasheet) to IO_REG register
   /**
    * write the defualt value to MAILBOX register
    * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
    */
-  BQ51_ERR_RETURN_TYPE resetMAILBOX() { static uint8_t MB_def=BQ51_MAILBOX_default; return(writeBytes(BQ51_MAILBOX, &MB_def, 1)); } // write the default value (according to datasheet) to MAILBOX register
+  BQ51_ERR_RETURN_TYPE resetMAILBOX() { return(_cachedWrite(BQ51_MAILBOX, BQ51_MAILBOX_default)); } // write the default value (according to datasheet) to MAILBOX register
   /**
    * write default values to all (write-access) registers, resetting the output voltage, FOD adjustments and custom proprietary packets/headers
-   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
+   * (all 3 ranges are written, even if one fails)
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully (the first error, if any)
    */
   BQ51_ERR_RETURN_TYPE resetAllRegisters() {
     static uint8_t defaults[3][4] = {{BQ51_VO_REG_default,BQ51_IO_REG_default,(0),(0)},{BQ51_MAILBOX_default,0,0,(0)},{0,0,0,0}};
-    return(writeBytes(BQ51_VO_REG, defaults[0], 2)); // reset BQ51_VO_REG and BQ51_IO_REG
-    return(writeBytes(BQ51_MAILBOX, defaults[1], 3)); // reset BQ51_MAILBOX, BQ51_FOD_RAM and BQ51_USER_HEADER_RAM
-    return(writeBytes(BQ51_PACKET_PAYLOAD, defaults[2], 4)); // reset all 4 bytes of BQ51_PACKET_PAYLOAD
+    shadowInvalidate(); // (the shadow copy will be refilled on the next access)
+    BQ51_ERR_RETURN_TYPE err = writeBytes(BQ51_VO_REG, defaults[0], 2); // reset BQ51_VO_REG and BQ51_IO_REG
+    BQ51_ERR_RETURN_TYPE rangeErr = writeBytes(BQ51_MAILBOX, defaults[1], 3); // reset BQ51_MAILBOX, BQ51_FOD_RAM and BQ51_USER_HEADER_RAM
+    if(_errGood(err)) { err = rangeErr; }
+    rangeErr = writeBytes(BQ51_PACKET_PAYLOAD, defaults[2], 4); // reset all 4 bytes of BQ51_PACKET_PAYLOAD
+    if(_errGood(err)) { err = rangeErr; }
+    return(err);
   }
 };
 
+/**
+ * BQ51_thijs for a specific chip variant (known at compile time), like: BQ51_thijs_variant<BQ51_CHIP_BQ5122x> BQ51;
+ * The functions the chip doesn't have are deleted (so using them is a compile error, instead of a runtime debug message),
+ *  and the ones it does have skip the isBQ51021 check.
+ * It's still a BQ51_thijs (isBQ51021 is set accordingly), so it can be passed to all the add-ons.
+ * NOTE: through a BQ51_thijs& (like the add-ons normally take), the chip is only known at runtime again, and the deleted functions are reachable.
+ *  The polling add-ons (presence, session, replay) can take the variant type as a template parameter instead
+ *  (like BQ51_thijs_presenceFor<BQ51_thijs_variant<BQ51_CHIP_BQ5122x>>), so their isBQ51021 checks are resolved at compile time (see BQ51_isBQ51021()).
+ */
+template<BQ51_CHIP_ENUM CHIP> class BQ51_thijs_variant;
+
+template<>
+class BQ51_thijs_variant<BQ51_CHIP_BQ5122x> : public BQ51_thijs
+{
+  public:
+  BQ51_thijs_variant() : BQ51_thijs(false) {}
+
+  /**
+   * retrieve V_RECT, V_OUT and REC_PWR (and optionally MODE_IND) in a single (burst) read, see BQ51_thijs::readTelemetry()
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote/read successfully
+   */
+  BQ51_ERR_RETURN_TYPE readTelemetry(BQ51_telemetry& readBuff, bool includeMODE_IND=false) { return(_readTelemetry(readBuff, includeMODE_IND)); }
+  /**
+   * retrieve the (whole) Mode Indicator register
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote/read successfully
+   */
+  BQ51_ERR_RETURN_TYPE getMODE_IND(uint8_t& readBuff) { return(requestReadBytes(BQ51_MODE_IND, &readBuff, 1)); }
+  /**
+   * retrieve the (whole) Mode Indicator register
+   * @return Wireless Power Mode Indicator Register (indicates Qi or PMA, and Alignment-mode)
+   */
+  uint8_t getMODE_IND() { uint8_t retVal=0; getMODE_IND(retVal); return(retVal); } // just a macro
+  /**
+   * retrieve the ALIGN Status bit from the Mode Indicator register
+   * @return ALIGN Status. 1=Alignment_mode, 0=Normal_operation
+   */
+  bool getMODE_IND_ALIGN() { return(BQ51_MODE_IND_ALIGN_field::decode(getMODE_IND()) != 0); }
+  /**
+   * retrieve the Mode bit from the Mode Indicator register
+   * @return Mode bit, 1=PMA, 0=WPC(Qi)
+   */
+  bool getMODE() { return(BQ51_MODE_IND_MODE_field::decode(getMODE_IND()) != 0); }
+  /**
+   * retrieve the Wireless Power Readback Register (unique ID for each device, programmed at factory)
+   * @param readBuff 6-byte (BQ51_RXID_size) buffer
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote/read successfully
+   */
+  BQ51_ERR_RETURN_TYPE getRXID(uint8_t readBuff[]) { return(requestReadBytes(BQ51_RXID_READBACK, readBuff, BQ51_RXID_size)); }
+};
+
+template<>
+class BQ51_thijs_variant<BQ51_CHIP_BQ51021> : public BQ51_thijs
+{
+  public:
+  BQ51_thijs_variant() : BQ51_thijs(true) {}
+
+  /**
+   * retrieve V_RECT, V_OUT and REC_PWR in a single (burst) read, see BQ51_thijs::readTelemetry()
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote/read successfully
+   */
+  BQ51_ERR_RETURN_TYPE readTelemetry(BQ51_telemetry& readBuff) { return(_readTelemetry(readBuff, false)); }
+  //// the BQ51021 doesn't have these:
+  BQ51_ERR_RETURN_TYPE readTelemetry(BQ51_telemetry& readBuff, bool includeMODE_IND) = delete;
+  BQ51_ERR_RETURN_TYPE getMODE_IND(uint8_t& readBuff) = delete;
+  uint8_t getMODE_IND() = delete;
+  bool getMODE_IND_ALIGN() = delete;
+  bool getMODE() = delete;
+  BQ51_ERR_RETURN_TYPE getRXID(uint8_t readBuff[]) = delete;
+};
+
+/**
+ * whether a device is a BQ51021, for the add-ons that are templated on the device type:
+ *  the (runtime) isBQ51021 flag for a BQ51_thijs, and a compile-time constant for a BQ51_thijs_variant
+ */
+inline bool BQ51_isBQ51021(const BQ51_thijs& device) { return(device.isBQ51021); }
+constexpr bool BQ51_isBQ51021(const BQ51_thijs_variant<BQ51_CHIP_BQ5122x>&) { return(false); }
+constexpr bool BQ51_isBQ51021(const BQ51_thijs_variant<BQ51_CHIP_BQ51021>&) { return(true); }
+
 #endif  // BQ51_thijs_h
\ No newline at end of file
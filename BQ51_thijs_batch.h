@@ -0,0 +1,167 @@
+/*
+an add-on for BQ51_thijs, for changing several settings in as few transactions as possible
+Every setter (setVO_REG(), setFOD_RO(), setUSER_HEADER(), etc.) is its own transaction (and the field setters read the register first,
+ unless BQ51_useShadowCache is defined), so reconfiguring a receiver easily takes a dozen transactions.
+This class stages any number of register/field changes in RAM, and commit() writes them out per range of contiguous (writable) registers:
+- range 0: VO_REG, IO_REG                            (0x01 ~ 0x02)
+- range 1: MAILBOX, FOD_RAM, USER_HEADER_RAM         (0xE0 ~ 0xE2)
+- range 2: PACKET_PAYLOAD (4 bytes)                  (0xF1 ~ 0xF4)
+Each range with staged changes is written in a single burst write, from the first to the last changed register.
+Registers in that span that are not (fully) staged need their current value first: those come from the shadow copy (if valid),
+ otherwise the whole span is read in one burst read. So a commit takes 1~3 writes (and at most 1 read per range).
+The MAILBOX is written with USER_PKT_DONE=1 (unless it was staged explicitly), so a commit never triggers a packet by accident,
+ the (read-only) ERR bits are written as 0, and the FOD Scaler bit is kept 0 (like _setBits() does).
+The result of each range is reported in rangeResult[], and ranges that failed stay staged (so commit() can simply be retried).
+*/
+
+#ifndef BQ51_thijs_batch_h
+#define BQ51_thijs_batch_h
+
+#include "BQ51_thijs.h"
+
+#define BQ51_BATCH_RANGES  3 // number of contiguous writable register ranges (see top)
+
+/**
+ * stages register and field changes, and writes them in the fewest burst writes
+ */
+class BQ51_thijs_batch
+{
+  public:
+  BQ51_ERR_RETURN_TYPE rangeResult[BQ51_BATCH_RANGES]; // result of each range at the last commit() (BQ51_ERR_GOOD if nothing was staged in it)
+  uint8_t transactions = 0; // number of I2C transactions the last commit() took
+
+  BQ51_thijs_batch(BQ51_thijs& device) : _device(device) { clear(); for(uint8_t i=0; i<BQ51_BATCH_RANGES; i++) { rangeResult[i] = BQ51_ERR_GOOD; } }
+
+  /**
+   * forget all staged changes
+   */
+  void clear() { memset(_value, 0, sizeof(_value));  memset(_mask, 0, sizeof(_mask)); }
+
+  /**
+   * @return whether there are any staged changes
+   */
+  bool pending() const { for(uint8_t i=0; i<_imageSize; i++) { if(_mask[i]) { return(true); } } return(false); }
+
+  /**
+   * @param reg register byte (see list of defines at top of BQ51_thijs.h)
+   * @return which bits of that register are staged (0 if none, or if the register is not writable)
+   */
+  uint8_t stagedMask(uint8_t reg) const { uint8_t index = _imageIndex(reg); return((index == 0xFF) ? 0 : _mask[index]); }
+
+  /**
+   * stage (some bits of) a register
+   * @param reg register byte (see list of defines at top of BQ51_thijs.h)
+   * @param newValue the new value (only the bits in mask are used)
+   * @param mask which bits to change (0xFF for the whole register)
+   * @return false if the register is not writable (not in any of the ranges)
+   */
+  bool setBits(uint8_t reg, uint8_t newValue, uint8_t mask) {
+    uint8_t index = _imageIndex(reg);
+    if(index == 0xFF) { BQ51debugPrint("BQ51_thijs_batch: register not writable"); return(false); }
+    _value[index] = (_value[index] & ~mask) | (newValue & mask);
+    _mask[index] |= mask;
+    return(true);
+  }
+  /**
+   * stage a whole register
+   * @param reg register byte (see list of defines at top of BQ51_thijs.h)
+   * @param newValue the new value
+   * @return false if the register is not writable (not in any of the ranges)
+   */
+  bool setRegister(uint8_t reg, uint8_t newValue) { return(setBits(reg, newValue, 0xFF)); }
+  /**
+   * stage one or more fields of the same register, like: setFields(BQ51_FOD_RO_field::with(3) | BQ51_FOD_RS_field::with(BQ51_RS_FOD_2x))
+   * @param fields the (combined) field values (see BQ51_fieldWrite)
+   */
+  template<uint8_t REG>
+  void setFields(BQ51_fieldWrite<REG> fields) { setBits(REG, fields.value, fields.mask); }
+  /**
+   * stage a single field, like: setField<BQ51_FOD_RO_field>(3)
+   * @param newVal field value (not shifted)
+   */
+  template<class FIELD>
+  void setField(uint8_t newVal) { setBits(FIELD::reg, FIELD::encode(newVal), FIELD::mask); }
+
+  //// (the most common ones, for convenience)
+  void setVO_REG(uint8_t newVal) { setRegister(BQ51_VO_REG, BQ51_VO_REG_field::encode(newVal)); }
+  void setIO_REG(BQ51_ILIM_ENUM newVal) { setRegister(BQ51_IO_REG, BQ51_IO_REG_field::encode(newVal)); }
+  void setFOD_RAM(uint8_t newVal) { setRegister(BQ51_FOD_RAM, newVal); }
+  void setUSER_HEADER(uint8_t newVal) { setRegister(BQ51_USER_HEADER_RAM, newVal); }
+  void setPACKET_PAYLOAD(const uint8_t newVal[]) { for(uint8_t i=0; i<BQ51_PACKET_PAYLOAD_size; i++) { setRegister(BQ51_PACKET_PAYLOAD + i, newVal[i]); } }
+
+  /**
+   * write all staged changes (1 burst write per range that has changes, see top)
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) the first error, or BQ51_ERR_GOOD if all ranges were written successfully
+   */
+  BQ51_ERR_RETURN_TYPE commit() {
+    BQ51_ERR_RETURN_TYPE firstErr = BQ51_ERR_GOOD;
+    transactions = 0;
+    for(uint8_t range=0; range<BQ51_BATCH_RANGES; range++) {
+      rangeResult[range] = _commitRange(range);
+      if(_device._errGood(firstErr) && !_device._errGood(rangeResult[range])) { firstErr = rangeResult[range]; }
+    }
+    return(firstErr);
+  }
+
+  private:
+  BQ51_thijs& _device;
+  static const uint8_t _imageSize = 2 + 3 + BQ51_PACKET_PAYLOAD_size;
+  uint8_t _value[_imageSize]; // staged values (of the bits in _mask)
+  uint8_t _mask[_imageSize];  // staged bits per register
+
+  static uint8_t _rangeStart(uint8_t range) { return((range == 0) ? BQ51_VO_REG : ((range == 1) ? BQ51_MAILBOX : BQ51_PACKET_PAYLOAD)); }
+  static uint8_t _rangeSize(uint8_t range) { return((range == 0) ? 2 : ((range == 1) ? 3 : BQ51_PACKET_PAYLOAD_size)); }
+  static uint8_t _rangeOffset(uint8_t range) { return((range == 0) ? 0 : ((range == 1) ? 2 : 5)); } // (index of the first register of the range in _value/_mask)
+
+  /**
+   * (private) find a register in the staged image
+   * @param reg register byte
+   * @return index in _value/_mask, or 0xFF if the register is not in any range
+   */
+  static uint8_t _imageIndex(uint8_t reg) {
+    for(uint8_t range=0; range<BQ51_BATCH_RANGES; range++) {
+      if((reg >= _rangeStart(range)) && (reg < (_rangeStart(range) + _rangeSize(range)))) { return(_rangeOffset(range) + reg - _rangeStart(range)); }
+    }
+    return(0xFF);
+  }
+
+  /**
+   * (private) write the staged changes of 1 range
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it read/wrote successfully (BQ51_ERR_GOOD if nothing was staged)
+   */
+  BQ51_ERR_RETURN_TYPE _commitRange(uint8_t range) {
+    const uint8_t offset = _rangeOffset(range);
+    uint8_t first = 0xFF, last = 0;
+    for(uint8_t i=0; i<_rangeSize(range); i++) { if(_mask[offset+i]) { if(first == 0xFF) { first = i; } last = i; } }
+    if(first == 0xFF) { return(BQ51_ERR_GOOD); } // nothing staged
+    const uint8_t startReg = _rangeStart(range) + first;
+    const uint8_t length = last - first + 1;
+    uint8_t buff[BQ51_PACKET_PAYLOAD_size] = {0}; // (the largest range)
+    bool needRead = false;
+    for(uint8_t i=0; i<length; i++) { // registers that aren't fully staged need their current value
+      if((_mask[offset+first+i] != 0xFF) && !_device._shadowGet(startReg + i, buff[i])) { needRead = true; }
+    }
+    BQ51_ERR_RETURN_TYPE err;
+    if(needRead) {
+      uint8_t readBuff[BQ51_PACKET_PAYLOAD_size];
+      err = _device.requestReadBytes(startReg, readBuff, length);  transactions++;
+      if(!_device._errGood(err)) { return(err); }
+      for(uint8_t i=0; i<length; i++) { if(_mask[offset+first+i] != 0xFF) { buff[i] = readBuff[i]; } }
+    }
+    for(uint8_t i=0; i<length; i++) {
+      const uint8_t mask = _mask[offset+first+i];
+      buff[i] = (buff[i] & ~mask) | (_value[offset+first+i] & mask);
+      if((startReg + i) == BQ51_MAILBOX) {
+        if(!(mask & BQ51_MAILBOX_SEND_bits)) { buff[i] |= BQ51_MAILBOX_SEND_bits; } // don't trigger a packet, unless that was staged explicitly
+        buff[i] &= ~(BQ51_MAILBOX_ERR_bits | BQ51_MAILBOX_FOD_S_bits); // ERR is read-only (so always written as 0, like the shadow copy stores it), and FOD_S must be kept 0, according to datasheet
+      }
+    }
+    err = _device.writeBytes(startReg, buff, length);  transactions++;
+    if(!_device._errGood(err)) { _device.shadowInvalidate(); return(err); } // (if the write failed, the device contents are unknown)
+    for(uint8_t i=0; i<length; i++) { _device._shadowStore(startReg + i, buff[i]); }
+    memset(&_mask[offset], 0, _rangeSize(range));
+    return(err);
+  }
+};
+
+#endif // BQ51_thijs_batch_h
@@ -0,0 +1,164 @@
+/*
+an add-on for BQ51_thijs, for calibrating the Foreign Object Detection settings (FOD_RAM) unattended, like on a production test station
+The transmitter compares the power it sends with the received power the BQ51 reports (REC_PWR), and stops if too much goes missing
+ (which would be heating up a foreign object). The FOD_RAM settings adjust the reported power for the receiver's own losses:
+ RO_FOD adds a fixed offset (3bit, LSB = 39mW, if OFF_EN) and RS_FOD scales the ESR based loss estimate (see BQ51_RS_FOD_ENUM, if ESR_EN).
+Finding good values by hand takes minutes per board. run() sweeps every distinct combination (with both enable bits set):
+- 8 RO_FOD values * 5 distinct RS_FOD multipliers (the aliases of ESR*1 are skipped) = BQ51_FODCAL_STEPS steps
+- each step is 1 write (FOD_RAM), settle_ms of waiting, and then samplesPerStep telemetry reads (1 burst read each, see BQ51_thijs::readTelemetry())
+   every sampleInterval_ms, from which the mean/min/max REC_PWR is kept
+- each step is scored by how far the mean is from target_mW (the power that should be reported, e.g. measured by the test station),
+   plus spreadWeight_percent of the spread (max - min), so settings that make the reading jumpy rank lower. Lower scores are better.
+- if the TX cuts the power during a step (V_RECT < V_UVLO, or the device stops responding, as it runs off V_RECT), that step counts as tripped
+   (the worst score), and run() waits up to recover_ms for the power to come back before the next step
+Afterwards, results[] is ranked (best first), 'recommended' holds the best FOD_RAM byte, and (if applyBest) that is written to the device.
+With the defaults, a sweep takes 40 * (20ms + 8 * 5ms) = ~2.4 seconds.
+*/
+
+#ifndef BQ51_thijs_fodcal_h
+#define BQ51_thijs_fodcal_h
+
+#include "BQ51_thijs.h"
+
+#define BQ51_FODCAL_STEPS  40 // 8 RO_FOD values * 5 distinct RS_FOD multipliers
+#define BQ51_FODCAL_TRIPPED  0xFFFF // score of a step where the TX cut the power
+
+/**
+ * the result of 1 calibration step
+ */
+struct BQ51_fodResult {
+  uint8_t FOD_RAM;  // the FOD_RAM byte that was tested
+  uint16_t mean_mW; // mean reported REC_PWR
+  uint16_t min_mW;  // lowest reported REC_PWR
+  uint16_t max_mW;  // highest reported REC_PWR
+  uint16_t score;   // distance from target_mW + spread penalty (lower is better), BQ51_FODCAL_TRIPPED if the TX cut the power
+};
+
+/**
+ * FOD calibration: sweeps the RO_FOD/RS_FOD settings under load and ranks them
+ */
+class BQ51_thijs_fodcal
+{
+  public:
+  uint16_t target_mW = 0;            // the REC_PWR that should be reported under the test load (see top)
+  uint8_t spreadWeight_percent = 50; // how much the spread (max - min) of a step adds to its score
+  uint16_t settle_ms = 20;           // time between writing FOD_RAM and the first sample (for the TX and the load to settle)
+  uint8_t samplesPerStep = 8;        // telemetry reads per step
+  uint16_t sampleInterval_ms = 5;    // time between telemetry reads
+  uint16_t recover_ms = 1000;        // after a tripped step, wait up to this long for the power to come back
+  bool applyBest = true;             // write the recommended FOD_RAM after the sweep (otherwise, the original value is written back)
+  //// results (read-only):
+  BQ51_fodResult results[BQ51_FODCAL_STEPS]; // ranked (best first) after run()
+  uint8_t steps = 0;          // number of valid entries in results[]
+  uint8_t trips = 0;          // number of steps where the TX cut the power
+  uint8_t recommended = 0;    // the best FOD_RAM byte (or the original value, if every step tripped)
+  uint32_t transactions = 0;  // number of I2C transactions run() issued
+  uint32_t duration_ms = 0;   // how long run() took
+
+  BQ51_thijs_fodcal(BQ51_thijs& device) : _device(device) {}
+
+  /**
+   * sweep all FOD settings and rank them (blocking, see top for how long it takes). The device should be powered and under the test load.
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether the original FOD_RAM was read and the final FOD_RAM was written successfully
+   *          (NOTE: check trips and results[0].score as well)
+   */
+  BQ51_ERR_RETURN_TYPE run() {
+    uint32_t startMillis = millis();
+    steps = 0;  trips = 0;  transactions = 0;
+    uint8_t original;
+    BQ51_ERR_RETURN_TYPE err = _device.requestReadBytes(BQ51_FOD_RAM, &original, 1);  transactions++;
+    if(!_device._errGood(err)) { duration_ms = millis() - startMillis;  return(err); }
+    const uint8_t RSvalues[5] = {BQ51_RS_FOD_05x, BQ51_RS_FOD_1x, BQ51_RS_FOD_2x, BQ51_RS_FOD_3x, BQ51_RS_FOD_4x};
+    for(uint8_t i=0; i<sizeof(RSvalues); i++) {
+      for(uint8_t RO=0; RO<=BQ51_FOD_RO_field::decode(BQ51_FOD_RAM_RO_bits); RO++) {
+        uint8_t FOD = BQ51_FOD_RAM_ESR_EN_bits | BQ51_FOD_RAM_OFF_EN_bits | BQ51_FOD_RO_field::encode(RO) | BQ51_FOD_RS_field::encode(RSvalues[i]);
+        _measure(results[steps], FOD);
+        if(results[steps].score == BQ51_FODCAL_TRIPPED) { trips++;  _waitForPower(); }
+        steps++;
+      }
+    }
+    _rank();
+    recommended = (results[0].score != BQ51_FODCAL_TRIPPED) ? results[0].FOD_RAM : original;
+    err = _device.setFOD_RAM(applyBest ? recommended : original);  transactions++;
+    duration_ms = millis() - startMillis;
+    return(err);
+  }
+
+  /**
+   * write the ranked results as CSV (best first)
+   * @param out anything with print(const char*), print(unsigned long) and println() (like Serial)
+   */
+  template<class STREAM>
+  void dumpCSV(STREAM& out) const {
+    out.print("rank,FOD_RAM,RO_mW,RS_permille,mean_mW,min_mW,max_mW,score"); out.println();
+    for(uint8_t i=0; i<steps; i++) {
+      const BQ51_fodResult& result = results[i];
+      out.print((unsigned long)(i+1)); out.print(",");
+      out.print((unsigned long)result.FOD_RAM); out.print(",");
+      out.print((unsigned long)(BQ51_FOD_RO_field::decode(result.FOD_RAM) * BQ51_WATT_SCALAR_mW)); out.print(",");
+      out.print((unsigned long)BQ51_thijs::FOD_RS_permille(BQ51_FOD_RS_field::decode(result.FOD_RAM))); out.print(",");
+      out.print((unsigned long)result.mean_mW); out.print(",");
+      out.print((unsigned long)result.min_mW); out.print(",");
+      out.print((unsigned long)result.max_mW); out.print(",");
+      if(result.score == BQ51_FODCAL_TRIPPED) { out.print("tripped"); } else { out.print((unsigned long)result.score); }
+      out.println();
+    }
+  }
+
+  private:
+  BQ51_thijs& _device;
+
+  /**
+   * (private) write 1 FOD setting and collect the REC_PWR statistics
+   * @param result where to put the result
+   * @param FOD the FOD_RAM byte to test
+   */
+  void _measure(BQ51_fodResult& result, uint8_t FOD) {
+    result.FOD_RAM = FOD;  result.mean_mW = 0;  result.min_mW = 0;  result.max_mW = 0;  result.score = BQ51_FODCAL_TRIPPED;
+    BQ51_ERR_RETURN_TYPE err = _device.setFOD_RAM(FOD);  transactions++;
+    if(!_device._errGood(err)) { return; }
+    delay(settle_ms);
+    uint32_t sum_mW = 0;
+    for(uint8_t i=0; i<samplesPerStep; i++) {
+      if(i > 0) { delay(sampleInterval_ms); }
+      BQ51_telemetry telemetry;
+      err = _device.readTelemetry(telemetry);  transactions++;
+      if(!_device._errGood(err) || (telemetry.VRECT < BQ51_VRECT_UVLO_raw)) { return; } // the TX cut the power (FOD tripped), FOD_RAM is reset
+      if((i == 0) || (telemetry.REC_PWR_mW < result.min_mW)) { result.min_mW = telemetry.REC_PWR_mW; }
+      if((i == 0) || (telemetry.REC_PWR_mW > result.max_mW)) { result.max_mW = telemetry.REC_PWR_mW; }
+      sum_mW += telemetry.REC_PWR_mW;
+    }
+    if(samplesPerStep == 0) { return; }
+    result.mean_mW = sum_mW / samplesPerStep;
+    uint32_t score = ((result.mean_mW > target_mW) ? (result.mean_mW - target_mW) : (target_mW - result.mean_mW))
+                     + (((uint32_t)(result.max_mW - result.min_mW) * spreadWeight_percent) / 100);
+    result.score = (score < BQ51_FODCAL_TRIPPED) ? score : (BQ51_FODCAL_TRIPPED - 1);
+  }
+
+  /**
+   * (private) after a tripped step, wait (up to recover_ms) for the TX to power the receiver again
+   */
+  void _waitForPower() {
+    uint32_t startMillis = millis();
+    while((millis() - startMillis) < recover_ms) {
+      uint8_t VRECT;
+      BQ51_ERR_RETURN_TYPE err = _device.getVRECT(VRECT);  transactions++;
+      if(_device._errGood(err) && (VRECT >= BQ51_VRECT_UVLO_raw)) { return; }
+      delay(sampleInterval_ms);
+    }
+  }
+
+  /**
+   * (private) sort the results by score (best first). Insertion sort, which is stable, so equal scores keep the sweep order
+   */
+  void _rank() {
+    for(uint8_t i=1; i<steps; i++) {
+      BQ51_fodResult item = results[i];
+      uint8_t j = i;
+      while((j > 0) && (results[j-1].score > item.score)) { results[j] = results[j-1];  j--; }
+      results[j] = item;
+    }
+  }
+};
+
+#endif // BQ51_thijs_fodcal_h
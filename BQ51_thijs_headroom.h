@@ -0,0 +1,128 @@
+/*
+an add-on for BQ51_thijs, for (slowly) tuning VO_REG to keep the rectifier-to-output headroom (V_RECT - V_OUT) small
+The BQ51's output LDO drops (V_RECT - V_OUT), and burns (V_RECT - V_OUT) * I_OUT doing so. With VO_REG left at its default,
+ that headroom can be a few Volts, which makes the receiver run hot under load.
+This controller reads the telemetry (1 burst read, see BQ51_thijs::readTelemetry()) and steps VO_REG up (raising V_OUT)
+ when the headroom is larger than the target, and down when it's smaller:
+- there is a dead band of +-hysteresis_mV around the target, in which nothing happens.
+   NOTE: 1 VO_REG step (50mV) changes V_OUT by 50mV * (V_OUT / VO_REG), which is ~500mV for a 5V output. Make the dead band wider than that!
+- VO_REG is changed by at most 1 step per minStepInterval_ms, to give V_OUT (and the transmitter) time to settle
+- VO_REG is kept within [minBits, maxBits], so the output voltage stays within what the load can handle
+The LDO dissipation is estimated as (V_RECT - V_OUT) * REC_PWR / V_RECT (using I_OUT ~= I_RECT = REC_PWR / V_RECT),
+ and compared to the dissipation at the headroom that was measured when begin() was called (before any adjustments).
+Everything is integer math (milliVolts, milliWatts), so it also works with BQ51_noFloat.
+*/
+
+#ifndef BQ51_thijs_headroom_h
+#define BQ51_thijs_headroom_h
+
+#include "BQ51_thijs.h"
+
+/**
+ * closed-loop VO_REG controller, which keeps the LDO headroom (V_RECT - V_OUT) near a target
+ */
+class BQ51_thijs_headroom
+{
+  public:
+  uint16_t targetHeadroom_mV = 500;   // desired V_RECT - V_OUT
+  uint16_t hysteresis_mV = 400;       // no adjustments while the headroom is within target +- this (see NOTE at top)
+  uint16_t minStepInterval_ms = 1000; // rate limit: max 1 VO_REG step per this many milliseconds
+  uint8_t minBits = 0;                // lowest VO_REG bits the controller may use (0 = 450mV)
+  uint8_t maxBits = BQ51_VO_REG_bits; // highest VO_REG bits the controller may use (7 = 800mV)
+  //// results (read-only):
+  uint16_t headroom_mV = 0;           // V_RECT - V_OUT at the last update() (0 if V_OUT > V_RECT)
+  uint16_t dissipation_mW = 0;        // estimated LDO dissipation at the last update()
+  int16_t savedPower_mW = 0;          // estimated dissipation saved (compared to the headroom at begin()), negative if it's worse
+  int32_t savedEnergy_mJ = 0;         // savedPower_mW, integrated over time (only while powered)
+  uint32_t steps = 0;                 // number of times VO_REG was changed
+  uint32_t readErrors = 0;            // failed telemetry reads
+
+  BQ51_thijs_headroom(BQ51_thijs& device) : _device(device) {}
+
+  /**
+   * start controlling (reads the current VO_REG and measures the baseline headroom)
+   * NOTE: if the device isn't powered yet, the baseline is taken at the first powered update() instead
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it read successfully
+   */
+  BQ51_ERR_RETURN_TYPE begin() {
+    BQ51_ERR_RETURN_TYPE err = _device.getVO_REG(_bits);
+    if(!_device._errGood(err)) { return(err); }
+    _initialBits = _bits;
+    _baselineHeadroom_mV = 0;  _baselineKnown = false;
+    _lastStep_ms = millis() - minStepInterval_ms; // allow the first step right away
+    _lastUpdate_ms = millis();
+    _energyRemainder = 0;
+    return(update(false));
+  }
+
+  /**
+   * read the telemetry, update the estimates and (if needed and allowed) step VO_REG. Call this periodically.
+   * @param allowStep whether VO_REG may be changed during this update (false to only update the estimates)
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote/read successfully
+   */
+  BQ51_ERR_RETURN_TYPE update(bool allowStep=true) {
+    BQ51_telemetry telemetry;
+    BQ51_ERR_RETURN_TYPE err = _device.readTelemetry(telemetry);
+    uint32_t now = millis();
+    uint32_t dt_ms = now - _lastUpdate_ms;  _lastUpdate_ms = now;
+    if(!_device._errGood(err)) { readErrors++; return(err); }
+    if(telemetry.VRECT < BQ51_VRECT_UVLO_raw) { // not (properly) powered, nothing to control
+      headroom_mV = 0;  dissipation_mW = 0;  savedPower_mW = 0;
+      return(err);
+    }
+    headroom_mV = (telemetry.VRECT_mV > telemetry.VOUT_mV) ? (telemetry.VRECT_mV - telemetry.VOUT_mV) : 0;
+    if(!_baselineKnown) { _baselineHeadroom_mV = headroom_mV;  _baselineKnown = true; }
+    dissipation_mW = _dissipation_mW(headroom_mV, telemetry);
+    savedPower_mW = (int16_t)_dissipation_mW(_baselineHeadroom_mV, telemetry) - (int16_t)dissipation_mW;
+    savedEnergy_mJ += (int32_t)savedPower_mW * (int32_t)(dt_ms / 1000); // (whole seconds: mW * s = mJ, as mW * ms overflows 32bits after ~3.6 minutes)
+    _energyRemainder += (int32_t)savedPower_mW * (int32_t)(dt_ms % 1000); // (the rest: mW * ms = uJ)
+    savedEnergy_mJ += _energyRemainder / 1000;  _energyRemainder %= 1000;
+    if(!allowStep || ((now - _lastStep_ms) < minStepInterval_ms)) { return(err); } // rate limit
+    uint8_t newBits = _bits;
+    if((headroom_mV > (targetHeadroom_mV + hysteresis_mV)) && (_bits < maxBits)) { newBits++; } // too much headroom, raise V_OUT
+    else if(((headroom_mV + hysteresis_mV) < targetHeadroom_mV) && (_bits > minBits)) { newBits--; } // too little headroom, lower V_OUT
+    if(newBits == _bits) { return(err); }
+    err = _device.setVO_REG(newBits);
+    if(!_device._errGood(err)) { return(err); }
+    _bits = newBits;  steps++;
+    _lastStep_ms = now;
+    return(err);
+  }
+
+  /**
+   * @return the VO_REG bits the controller currently uses
+   */
+  uint8_t VO_REG_bits() const { return(_bits); }
+
+  /**
+   * stop controlling, and put VO_REG back to what it was at begin()
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
+   */
+  BQ51_ERR_RETURN_TYPE end() {
+    BQ51_ERR_RETURN_TYPE err = _device.setVO_REG(_initialBits);
+    if(_device._errGood(err)) { _bits = _initialBits; }
+    return(err);
+  }
+
+  private:
+  BQ51_thijs& _device;
+  uint8_t _bits = BQ51_VO_REG_default;
+  uint8_t _initialBits = BQ51_VO_REG_default;
+  uint16_t _baselineHeadroom_mV = 0;
+  bool _baselineKnown = false;
+  uint32_t _lastStep_ms = 0;
+  uint32_t _lastUpdate_ms = 0;
+  int32_t _energyRemainder = 0; // (microJoules) leftover of savedEnergy_mJ
+
+  /**
+   * estimate the LDO dissipation: headroom * I_OUT, where I_OUT ~= REC_PWR / V_RECT
+   * @param headroom V_RECT - V_OUT in milliVolts
+   * @param telemetry (powered) telemetry, for REC_PWR and V_RECT
+   * @return estimated dissipation in milliWatts
+   */
+  static uint16_t _dissipation_mW(uint16_t headroom, const BQ51_telemetry& telemetry) {
+    return(((uint32_t)headroom * telemetry.REC_PWR_mW) / telemetry.VRECT_mV); // (max 11730 * 9945, fits in 32bits. V_RECT_mV is never 0 here, as V_RECT >= UVLO)
+  }
+};
+
+#endif // BQ51_thijs_headroom_h
@@ -0,0 +1,168 @@
+
+// https://www.ti.com/lit/ds/symlink/tca9548a.pdf
+/*
+an add-on for BQ51_thijs, for using multiple BQ51's behind a TCA9548A-style I2C multiplexer
+All BQ51's have the same (fixed) I2C address (0x6C), so the only way to talk to several of them on one bus is through a mux.
+This class keeps track of which mux channel is currently selected, and only writes to the mux when the target device changes.
+pollAll() goes through the devices sorted by channel (alternating direction every sweep),
+ so the last channel of one sweep is the first channel of the next one (saving a mux write per sweep).
+
+The mux is written to through a user-supplied function, as the BQ51_thijs I2C functions only talk to the BQ51 address.
+(if BQ51_useWireLib is defined, BQ51_muxWriteWire() can be used)
+
+NOTE: if anything else changes the mux channel behind this class's back, call invalidate()
+*/
+
+#ifndef BQ51_thijs_mux_h
+#define BQ51_thijs_mux_h
+
+#include "BQ51_thijs.h"
+
+#define BQ51_MUX_ADDRESS_default  0x70 // TCA9548A address with A0~A2 pulled low
+#define BQ51_MUX_CHANNEL_unknown  0xFF // (internal) the current mux channel is unknown, the next select() will always write
+
+/**
+ * function that writes the control byte to the mux (for the TCA9548A, each bit enables 1 channel)
+ * @param muxAddress 7-bit I2C address of the mux
+ * @param controlByte the byte to write
+ * @return whether it wrote successfully
+ */
+typedef bool (*BQ51_muxWriteFunc)(uint8_t muxAddress, uint8_t controlByte);
+
+#ifdef BQ51_useWireLib
+  /**
+   * mux write function for the Wire.h library (pass this to the BQ51_thijs_mux constructor)
+   * @param muxAddress 7-bit I2C address of the mux
+   * @param controlByte the byte to write
+   * @return whether it wrote successfully
+   */
+  inline bool BQ51_muxWriteWire(uint8_t muxAddress, uint8_t controlByte) {
+    Wire.beginTransmission(muxAddress);
+    Wire.write(controlByte);
+    return(Wire.endTransmission() == 0);
+  }
+#endif
+
+/**
+ * manages several BQ51_thijs objects behind a single I2C multiplexer
+ * @tparam deviceCount max number of BQ51_thijs objects
+ */
+template<uint8_t deviceCount>
+class BQ51_thijs_mux
+{
+  public:
+  const uint8_t muxAddress;
+  uint32_t muxWrites = 0; // number of times the mux was actually written to (for checking how much select() saves)
+
+  /**
+   * @param muxWrite function that writes the control byte to the mux
+   * @param muxAddress 7-bit I2C address of the mux
+   */
+  BQ51_thijs_mux(BQ51_muxWriteFunc muxWrite, uint8_t muxAddress=BQ51_MUX_ADDRESS_default) : muxAddress(muxAddress), _muxWrite(muxWrite) {}
+
+  /**
+   * add a BQ51_thijs object (which should already be initialized) to the manager
+   * @param device the BQ51_thijs object
+   * @param channel mux channel the device is on (0~7)
+   * @return index of the device (for select() and device()), or 0xFF if there's no more room (or the channel is invalid)
+   */
+  uint8_t attach(BQ51_thijs& device, uint8_t channel) {
+    if(channel >= 8) { BQ51debugPrint("BQ51_thijs_mux channel must be 0~7!"); return(0xFF); } // (the control byte has 1 bit per channel)
+    if(_count >= deviceCount) { BQ51debugPrint("BQ51_thijs_mux full!"); return(0xFF); }
+    uint8_t index = _count++;
+    _devices[index] = &device;
+    _channels[index] = channel;
+    uint8_t i = index; // insertion sort (by channel) into the poll order
+    while((i > 0) && (_channels[_order[i-1]] > channel)) { _order[i] = _order[i-1]; i--; }
+    _order[i] = index;
+    return(index);
+  }
+
+  /**
+   * @return number of attached devices
+   */
+  uint8_t count() const { return(_count); }
+
+  /**
+   * switch the mux to the channel of a device (only writes to the mux if the channel is different from the current one)
+   * @param index index of the device (as returned by attach())
+   * @return whether the channel is selected
+   */
+  bool select(uint8_t index) {
+    if(index >= _count) { return(false); }
+    uint8_t channel = _channels[index];
+    if(channel == _currentChannel) { return(true); } // nothing to do
+    muxWrites++;
+    if(!_muxWrite(muxAddress, 1 << channel)) { BQ51debugPrint("BQ51_thijs_mux write failed!"); _currentChannel = BQ51_MUX_CHANNEL_unknown; return(false); }
+    _currentChannel = channel;
+    return(true);
+  }
+
+  /**
+   * select a device and return it (for one-off accesses, like: if(BQ51_thijs* BQ51 = mux.device(2)) { BQ51->setVO_REG(3); } )
+   * NOTE: check the return value of select() instead if you need to know whether the mux write worked
+   * @param index index of the device (as returned by attach())
+   * @return pointer to the BQ51_thijs object, or NULL if the index is invalid (or nothing is attached)
+   */
+  BQ51_thijs* device(uint8_t index) {
+    if((index >= _count) || (index >= deviceCount)) { BQ51debugPrint("BQ51_thijs_mux invalid device index!"); return(NULL); } // (_count <= deviceCount, but the compiler can't tell)
+    select(index);
+    return(_devices[index]);
+  }
+
+  /**
+   * forget which channel is selected, so the next select() will always write to the mux
+   */
+  void invalidate() { _currentChannel = BQ51_MUX_CHANNEL_unknown; }
+
+  /**
+   * disable all mux channels (also useful to get the mux into a known state)
+   * @return whether it wrote successfully
+   */
+  bool deselectAll() {
+    muxWrites++;
+    bool success = _muxWrite(muxAddress, 0);
+    _currentChannel = BQ51_MUX_CHANNEL_unknown; // (0 channels selected is not a channel, so the next select() writes anyway)
+    return(success);
+  }
+
+  /**
+   * call a function for every device, in channel order, switching the mux as little as possible
+   * @param pollFunc function (or lambda) like: bool pollFunc(uint8_t index, BQ51_thijs& device), which does all the accesses for that device
+   * @return number of devices for which the mux switch and pollFunc succeeded
+   */
+  template<class FUNC>
+  uint8_t pollAll(FUNC pollFunc) {
+    uint8_t successes = 0;
+    for(uint8_t i=0; i<_count; i++) {
+      uint8_t index = _order[_sweepReverse ? (_count-1-i) : i];
+      if(!select(index)) { continue; }
+      if(pollFunc(index, *_devices[index])) { successes++; }
+    }
+    _sweepReverse = !_sweepReverse; // the next sweep starts where this one ended
+    return(successes);
+  }
+
+  /**
+   * read the telemetry of all devices (one mux switch and one burst read per device)
+   * @param readBuff array of (deviceCount) BQ51_telemetry structs, indexed the same as the devices
+   * @param includeMODE_IND see BQ51_thijs::readTelemetry()
+   * @return number of devices that were read successfully
+   */
+  uint8_t readTelemetryAll(BQ51_telemetry readBuff[], bool includeMODE_IND=false) {
+    return(pollAll([readBuff, includeMODE_IND](uint8_t index, BQ51_thijs& device) {
+      return(device._errGood(device.readTelemetry(readBuff[index], includeMODE_IND)));
+    }));
+  }
+
+  private:
+  BQ51_muxWriteFunc _muxWrite;
+  BQ51_thijs* _devices[deviceCount];
+  uint8_t _channels[deviceCount];
+  uint8_t _order[deviceCount]; // device indices, sorted by channel
+  uint8_t _count = 0;
+  uint8_t _currentChannel = BQ51_MUX_CHANNEL_unknown;
+  bool _sweepReverse = false;
+};
+
+#endif // BQ51_thijs_mux_h
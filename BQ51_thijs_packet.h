@@ -0,0 +1,164 @@
+
+/*
+an add-on for BQ51_thijs, for sending proprietary Qi packets without blocking (or hogging the bus)
+Sending a packet manually goes like: setPACKET_PAYLOAD(), setUSER_HEADER(), setMAILBOX_SEND(), and then polling getMAILBOX_SEND() until it reads 1.
+This class queues packets (enqueue() returns immediately), and pump() does the rest in the background:
+- the payload and header are only written if they differ from what's (known to be) in the device already
+- the send trigger is a single write (if BQ51_useShadowCache is defined, otherwise the MAILBOX register is read first)
+- USER_PKT_DONE is polled with exponential backoff (instead of continuously), and every poll also reads back the header,
+   which tells whether the device was reset (V_RECT < V_UVLO) in the meantime (reported as BQ51_PACKET_reset)
+- the result of each packet (including BQ51_MAILBOX_ERR_no_TX and _bad_header) is reported through a callback
+
+The datasheet is pretty vague about the packet sending process, so the timing parameters are public members you can tune.
+*/
+
+#ifndef BQ51_thijs_packet_h
+#define BQ51_thijs_packet_h
+
+#include "BQ51_thijs.h"
+
+enum BQ51_PACKET_RESULT_ENUM : uint8_t { // result of sending a packet (the first 4 are the same as BQ51_MAILBOX_ERR_ENUM)
+  BQ51_PACKET_sent       = BQ51_MAILBOX_ERR_good,       // No error in sending packet
+  BQ51_PACKET_no_TX      = BQ51_MAILBOX_ERR_no_TX,      // Error: no transmitter present
+  BQ51_PACKET_bad_header = BQ51_MAILBOX_ERR_bad_header, // Illegal header found: packet will not be sent
+  BQ51_PACKET_err_TBD    = BQ51_MAILBOX_ERR_err_TBD,    // Error: not defined yet
+  BQ51_PACKET_I2C_error  = 4, // the packet could not be written to the device
+  BQ51_PACKET_timeout    = 5, // USER_PKT_DONE did not become 1 within timeout_ms
+  BQ51_PACKET_reset      = 6  // the device was reset (V_RECT < V_UVLO) while sending, so the packet was lost
+};
+
+struct BQ51_packet {
+  uint8_t header;  // written to BQ51_USER_HEADER_RAM
+  uint8_t payload[BQ51_PACKET_PAYLOAD_size]; // written to BQ51_PACKET_PAYLOAD
+  uint8_t id;      // (not sent) user-defined number, for recognizing the packet in the callback
+};
+
+/**
+ * function to be called when a packet is done (sent or failed)
+ * @param packet the packet
+ * @param result whether it was sent (see BQ51_PACKET_RESULT_ENUM)
+ * @param arg the (user) argument that was passed to setCallback()
+ */
+typedef void (*BQ51_packetCallback)(const BQ51_packet& packet, BQ51_PACKET_RESULT_ENUM result, void* arg);
+
+/**
+ * non-blocking transmit queue for proprietary Qi packets
+ * @tparam queueLength max number of packets waiting to be sent
+ */
+template<uint8_t queueLength>
+class BQ51_thijs_packetQueue
+{
+  public:
+  uint32_t minBackoff_us = 1000;  // first USER_PKT_DONE poll happens this long after the send trigger
+  uint32_t maxBackoff_us = 32000; // the poll interval doubles every time, up to this
+  uint16_t timeout_ms = 500;      // give up waiting for USER_PKT_DONE after this long
+  uint32_t transactions = 0;      // number of I2C transactions issued (not counting the MAILBOX read setMAILBOX_SEND() does without BQ51_useShadowCache)
+
+  BQ51_thijs_packetQueue(BQ51_thijs& device) : _device(device) {}
+
+  /**
+   * @param callback function to call when a packet is done (may be NULL)
+   * @param arg argument to pass to the callback
+   */
+  void setCallback(BQ51_packetCallback callback, void* arg=NULL) { _callback = callback; _callbackArg = arg; }
+
+  /**
+   * add a packet to the queue (returns immediately, call pump() to actually send it)
+   * @param header the user header (see BQ51_USER_HEADER_RAM)
+   * @param payload 4-byte payload (copied)
+   * @param id (optional) user-defined number, for recognizing the packet in the callback
+   * @return false if the queue is full
+   */
+  bool enqueue(uint8_t header, const uint8_t payload[], uint8_t id=0) {
+    if(_count >= queueLength) { return(false); }
+    BQ51_packet& packet = _queue[(_first + _count) % queueLength];
+    packet.header = header;  packet.id = id;
+    memcpy(packet.payload, payload, BQ51_PACKET_PAYLOAD_size);
+    _count++;
+    return(true);
+  }
+
+  /**
+   * @return number of packets queued or in progress
+   */
+  uint8_t pending() const { return(_count); }
+
+  /**
+   * do the next step of sending packets, if it's time for one (call this as often as possible)
+   * @return whether a packet finished (callback called) during this call
+   */
+  bool pump() {
+    if(_count == 0) { return(false); }
+    if(!_waiting) { return(_startSend()); }
+    uint32_t now = micros();
+    if((int32_t)(now - _nextPoll_us) < 0) { return(false); } // not time yet
+    uint8_t readBuff[BQ51_USER_HEADER_RAM - BQ51_MAILBOX + 1]; // MAILBOX, FOD_RAM and USER_HEADER_RAM in one read
+    transactions++;
+    if(!_device._errGood(_device.requestReadBytes(BQ51_MAILBOX, readBuff, sizeof(readBuff)))) { _regsKnown = false; return(_finish(BQ51_PACKET_I2C_error)); }
+    for(uint8_t i=0; i<sizeof(readBuff); i++) { _device._shadowStore(BQ51_MAILBOX + i, readBuff[i]); } // might as well keep the shadow copy up to date
+    if(readBuff[BQ51_USER_HEADER_RAM - BQ51_MAILBOX] != _queue[_first].header) { // the device was reset in the meantime, so the payload is gone as well
+      _regsKnown = false;
+      return(_finish(BQ51_PACKET_reset)); // (the MAILBOX is back at its default (USER_PKT_DONE=1, no error), which would look like a successful send)
+    }
+    if(readBuff[0] & BQ51_MAILBOX_SEND_bits) { // USER_PKT_DONE
+      return(_finish(static_cast<BQ51_PACKET_RESULT_ENUM>(BQ51_MAILBOX_ERR_field::decode(readBuff[0]))));
+    }
+    if((millis() - _sendStart_ms) > timeout_ms) { return(_finish(BQ51_PACKET_timeout)); }
+    _backoff_us = ((_backoff_us * 2) < maxBackoff_us) ? (_backoff_us * 2) : maxBackoff_us;
+    _nextPoll_us = now + _backoff_us;
+    return(false);
+  }
+
+  /**
+   * forget what's (thought to be) in the device's header and payload registers, so the next packet writes them regardless
+   */
+  void invalidate() { _regsKnown = false; }
+
+  private:
+  BQ51_thijs& _device;
+  BQ51_packet _queue[queueLength];
+  uint8_t _first = 0;  // index of the oldest packet in _queue
+  uint8_t _count = 0;  // packets in _queue (the oldest one may be in progress)
+  bool _waiting = false; // whether the oldest packet has been triggered and is waiting for USER_PKT_DONE
+  bool _regsKnown = false; // whether _lastHeader and _lastPayload match the device registers
+  uint8_t _lastHeader = 0;
+  uint8_t _lastPayload[BQ51_PACKET_PAYLOAD_size];
+  uint32_t _nextPoll_us = 0;
+  uint32_t _backoff_us = 0;
+  uint32_t _sendStart_ms = 0;
+  BQ51_packetCallback _callback = NULL;
+  void* _callbackArg = NULL;
+
+  bool _startSend() {
+    BQ51_packet& packet = _queue[_first];
+    if(!(_regsKnown && (memcmp(_lastPayload, packet.payload, BQ51_PACKET_PAYLOAD_size) == 0))) {
+      transactions++;
+      if(!_device._errGood(_device.setPACKET_PAYLOAD(packet.payload))) { _regsKnown = false; return(_finish(BQ51_PACKET_I2C_error)); }
+      memcpy(_lastPayload, packet.payload, BQ51_PACKET_PAYLOAD_size);
+    }
+    if(!(_regsKnown && (_lastHeader == packet.header))) {
+      transactions++;
+      if(!_device._errGood(_device.setUSER_HEADER(packet.header))) { _regsKnown = false; return(_finish(BQ51_PACKET_I2C_error)); }
+      _lastHeader = packet.header;
+    }
+    _regsKnown = true;
+    transactions++;
+    if(!_device._errGood(_device.setMAILBOX_SEND())) { return(_finish(BQ51_PACKET_I2C_error)); }
+    _waiting = true;
+    _sendStart_ms = millis();
+    _backoff_us = minBackoff_us;
+    _nextPoll_us = micros() + _backoff_us;
+    return(false);
+  }
+
+  bool _finish(BQ51_PACKET_RESULT_ENUM result) {
+    BQ51_packet packet = _queue[_first]; // (copy, so the callback can enqueue() a new packet in the same slot)
+    _waiting = false;
+    _first = (_first + 1) % queueLength;
+    _count--;
+    if(_callback != NULL) { _callback(packet, result, _callbackArg); }
+    return(true);
+  }
+};
+
+#endif // BQ51_thijs_packet_h
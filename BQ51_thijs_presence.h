@@ -0,0 +1,154 @@
+/*
+an add-on for BQ51_thijs, for detecting when a transmitter (pad) shows up or goes away, without constantly hammering the bus
+poweredCheck() takes 2 transactions (RXID + V_RECT) every time, and only tells you the current state. This monitor:
+- reads V_RECT and MODE_IND in 1 burst read per poll (see BQ51_thijs::readTelemetry()). A NACK counts as 'no TX', as the BQ51 runs off V_RECT.
+- only when V_RECT rises above V_UVLO while no TX is known, also reads RXID (which reads all 1's while the output registers are held in reset),
+   to confirm the arrival (so that extra transaction only happens during transitions)
+- requires debounceSamples consecutive polls to agree before reporting a state change (so a pad being slid around doesn't spam events)
+- reports edges through a callback: TX arrived, TX lost, and a change between PMA and WPC(Qi) mode (not on the BQ51021)
+- adapts its poll period: fastPeriod_ms during transitions (a state change being debounced, or V_RECT moving more than activity_mV),
+   doubling after every quiet poll, up to maxPresentPeriod_ms (while powered) or maxAbsentPeriod_ms (while waiting for a TX).
+   So the worst-case latency of noticing a pad is roughly maxAbsentPeriod_ms + (debounceSamples-1) * fastPeriod_ms.
+BQ51_thijs_presence takes any BQ51_thijs. BQ51_thijs_presenceFor<BQ51_thijs_variant<...>> takes a specific chip variant,
+ so the BQ51021 checks (MODE_IND, RXID) are resolved at compile time (see BQ51_thijs_variant).
+*/
+
+#ifndef BQ51_thijs_presence_h
+#define BQ51_thijs_presence_h
+
+#include "BQ51_thijs.h"
+
+enum BQ51_PRESENCE_EVENT_ENUM : uint8_t {
+  BQ51_PRESENCE_arrived = 0,    // a TX started powering the receiver (V_RECT >= V_UVLO)
+  BQ51_PRESENCE_lost = 1,       // the TX went away (V_RECT < V_UVLO, or the device stopped responding)
+  BQ51_PRESENCE_modeChanged = 2 // the TX mode changed between PMA and WPC(Qi) (see isPMA)
+};
+
+/**
+ * function to be called when the presence of the TX (or its mode) changes
+ * @param event what happened (see BQ51_PRESENCE_EVENT_ENUM)
+ * @param VRECT_mV V_RECT at the poll that triggered the event
+ * @param isPMA whether the TX is in PMA mode (false for WPC(Qi), or if not present)
+ * @param arg the (user) argument that was passed to setCallback()
+ */
+typedef void (*BQ51_presenceCallback)(BQ51_PRESENCE_EVENT_ENUM event, uint16_t VRECT_mV, bool isPMA, void* arg);
+
+/**
+ * TX presence monitor with edge events and an adaptive poll period
+ * @tparam DEVICE BQ51_thijs, or a BQ51_thijs_variant (see top)
+ */
+template<class DEVICE>
+class BQ51_thijs_presenceFor
+{
+  public:
+  uint16_t fastPeriod_ms = 20;         // poll period during transitions
+  uint16_t maxPresentPeriod_ms = 1000; // longest poll period while a TX is present (and nothing is changing)
+  uint16_t maxAbsentPeriod_ms = 100;   // longest poll period while there is no TX (this sets the pad placement latency)
+  uint8_t debounceSamples = 2;         // consecutive polls that must agree before the state changes
+  uint16_t activity_mV = 5 * BQ51_VOLT_SCALAR_mV; // a V_RECT change (between polls) larger than this counts as a transition
+  //// state (read-only):
+  bool present = false;   // whether a TX is present (debounced)
+  bool isPMA = false;     // whether the TX is in PMA mode (only valid while present, always false on BQ51021)
+  uint16_t VRECT_mV = 0;  // V_RECT at the last poll
+  uint16_t period_ms = 0; // current poll period
+  uint32_t polls = 0;         // number of polls done
+  uint32_t transactions = 0;  // number of I2C transactions issued
+  uint32_t events = 0;        // number of events reported
+
+  BQ51_thijs_presenceFor(DEVICE& device) : _device(device) {}
+
+  /**
+   * set the function to be called when the presence (or mode) changes
+   * @param callback the function (or NULL to disable)
+   * @param arg (user) argument to pass along to the callback
+   */
+  void setCallback(BQ51_presenceCallback callback, void* arg=NULL) { _callback = callback; _callbackArg = arg; }
+
+  /**
+   * start monitoring (the first poll() will check right away). Does not report an event for a TX that is already present at the first check.
+   */
+  void begin() {
+    period_ms = fastPeriod_ms;
+    _nextDue = millis();
+    _pending = 0;  _started = false;
+  }
+
+  /**
+   * check the presence if it's time for it (call this as often as possible)
+   * @return whether an event was reported
+   */
+  bool poll() {
+    uint32_t now = millis();
+    if((int32_t)(now - _nextDue) < 0) { return(false); } // not time yet
+    bool eventReported = check();
+    _nextDue = now + period_ms; // (no need to catch up on missed polls, just poll again 1 period from now)
+    return(eventReported);
+  }
+
+  /**
+   * check the presence right now (and update the poll period)
+   * @return whether an event was reported
+   */
+  bool check() {
+    BQ51_telemetry telemetry;
+    bool includeMODE_IND = !BQ51_isBQ51021(_device);
+    BQ51_ERR_RETURN_TYPE err = _device._readTelemetry(telemetry, includeMODE_IND);  transactions++;  polls++; // (includeMODE_IND is already checked)
+    bool good = _device._errGood(err);
+    uint16_t newVRECT_mV = good ? telemetry.VRECT_mV : 0; // (the BQ51 runs off V_RECT, so no response means no TX)
+    bool candidate = good && (telemetry.VRECT >= BQ51_VRECT_UVLO_raw);
+    if(candidate && !present) { candidate = _RXIDvalid(); } // confirm the arrival (only happens during transitions)
+    bool newPMA = candidate && includeMODE_IND && (BQ51_MODE_IND_MODE_field::decode(telemetry.MODE_IND) != 0);
+    bool transition = (candidate != present) || (_difference(newVRECT_mV, VRECT_mV) > activity_mV);
+    VRECT_mV = newVRECT_mV;
+    bool eventReported = false;
+    if(!_started) { // the first check just establishes the state (no event)
+      present = candidate;  isPMA = newPMA;  _started = true;
+    } else if(candidate != present) {
+      _pending++;
+      if(_pending >= debounceSamples) {
+        present = candidate;  isPMA = newPMA;  _pending = 0;
+        _report(present ? BQ51_PRESENCE_arrived : BQ51_PRESENCE_lost);  eventReported = true;
+      }
+    } else {
+      _pending = 0;
+      if(present && (newPMA != isPMA)) { isPMA = newPMA;  _report(BQ51_PRESENCE_modeChanged);  eventReported = true;  transition = true; } // (the MODE bit is digital, no need to debounce)
+    }
+    //// adapt the poll period:
+    uint16_t maxPeriod_ms = present ? maxPresentPeriod_ms : maxAbsentPeriod_ms;
+    if(transition || (_pending > 0)) { period_ms = fastPeriod_ms; }
+    else { period_ms = ((period_ms * 2) < maxPeriod_ms) ? (period_ms * 2) : maxPeriod_ms; } // back off while nothing happens
+    return(eventReported);
+  }
+
+  private:
+  DEVICE& _device;
+  BQ51_presenceCallback _callback = NULL;
+  void* _callbackArg = NULL;
+  uint32_t _nextDue = 0;
+  uint8_t _pending = 0;  // consecutive polls that disagree with 'present'
+  bool _started = false;
+
+  static uint16_t _difference(uint16_t a, uint16_t b) { return((a > b) ? (a - b) : (b - a)); }
+
+  /**
+   * (private) check that the RXID is readable (it reads as all 1's while the output registers are held in reset)
+   * @return whether the RXID was read and is not all 1's
+   */
+  bool _RXIDvalid() {
+    if(BQ51_isBQ51021(_device)) { return(true); } // (the BQ51021 doesn't have RXID registers)
+    uint8_t RXID[BQ51_RXID_size];
+    BQ51_ERR_RETURN_TYPE err = _device.requestReadBytes(BQ51_RXID_READBACK, RXID, BQ51_RXID_size);  transactions++;
+    if(!_device._errGood(err)) { return(false); }
+    for(uint8_t i=0; i<BQ51_RXID_size; i++) { if(RXID[i] != 0xFF) { return(true); } }
+    return(false);
+  }
+
+  void _report(BQ51_PRESENCE_EVENT_ENUM event) {
+    events++;
+    if(_callback != NULL) { _callback(event, VRECT_mV, isPMA, _callbackArg); }
+  }
+};
+
+typedef BQ51_thijs_presenceFor<BQ51_thijs> BQ51_thijs_presence;
+
+#endif // BQ51_thijs_presence_h
@@ -0,0 +1,141 @@
+/*
+an add-on for BQ51_thijs, for keeping the output registers (MAILBOX, FOD_RAM, USER_HEADER_RAM) configured across UVLO resets
+Whenever V_RECT drops below V_UVLO (e.g. the phone/receiver is lifted off the pad), the 0xE0+ registers are reset,
+ so FOD tuning (setFOD_RO(), setFOD_RS(), setFOD_ESR_EN(), etc.) silently disappears. Instead of re-writing everything on a timer,
+ this class keeps a desired-state image of 0xE0 ~ 0xE2, and only writes it when the device doesn't match it:
+- update() replaces readTelemetry(): it starts the (same) burst read at 0xE0 instead of 0xE3 (9 bytes instead of 6, or 16 instead of 13 with MODE_IND),
+   so the current output registers come along for free. If the device is powered and the desired bits don't match,
+   the desired state is written in 1 burst write. So the steady-state cost is the same 1 transaction per update as readTelemetry().
+- apply() writes the desired state right away, without reading first. Call it when a reset is already known, like from a
+   BQ51_thijs_presence callback on BQ51_PRESENCE_arrived (then the next update() will just find that everything matches).
+Only the staged bits are compared and replayed, the other bits come from the read (or, for apply(), from the shadow copy or the reset defaults).
+The writes go through BQ51_thijs_batch (whole registers, so it never needs to read), with USER_PKT_DONE=1 in the MAILBOX (packets are never replayed).
+NOTE: the packet queue (BQ51_thijs_packet.h) writes USER_HEADER_RAM for every packet, so don't stage USER_HEADER_RAM here when using that.
+BQ51_thijs_replay takes any BQ51_thijs. BQ51_thijs_replayFor<BQ51_thijs_variant<...>> takes a specific chip variant,
+ so the BQ51021 check (MODE_IND) is resolved at compile time (see BQ51_thijs_variant).
+*/
+
+#ifndef BQ51_thijs_replay_h
+#define BQ51_thijs_replay_h
+
+#include "BQ51_thijs.h"
+#include "BQ51_thijs_batch.h"
+
+#define BQ51_REPLAY_SIZE  (BQ51_USER_HEADER_RAM - BQ51_MAILBOX + 1) // 0xE0 ~ 0xE2
+
+/**
+ * desired-state image of the output registers, re-applied after UVLO resets
+ * @tparam DEVICE BQ51_thijs, or a BQ51_thijs_variant (see top)
+ */
+template<class DEVICE>
+class BQ51_thijs_replayFor
+{
+  public:
+  bool includeMODE_IND = false; // see BQ51_thijs::readTelemetry()
+  //// results (read-only):
+  uint32_t replays = 0;       // number of times the desired state was (re)written
+  uint32_t transactions = 0;  // number of I2C transactions issued
+  uint32_t readErrors = 0;    // failed reads
+  uint32_t writeErrors = 0;   // failed writes
+
+  BQ51_thijs_replayFor(DEVICE& device) : _device(device) { clear(); }
+
+  /**
+   * forget the desired state (nothing will be replayed)
+   */
+  void clear() { memset(_value, 0, sizeof(_value));  memset(_mask, 0, sizeof(_mask)); }
+
+  /**
+   * set (some bits of) the desired state of an output register (this doesn't write anything, see update() and apply())
+   * @param reg register byte (BQ51_MAILBOX, BQ51_FOD_RAM or BQ51_USER_HEADER_RAM)
+   * @param newValue the new value (only the bits in mask are used)
+   * @param mask which bits to set (0xFF for the whole register)
+   * @return false if the register is not in 0xE0 ~ 0xE2
+   */
+  bool setBits(uint8_t reg, uint8_t newValue, uint8_t mask) {
+    if((reg < BQ51_MAILBOX) || (reg > BQ51_USER_HEADER_RAM)) { BQ51debugPrint("BQ51_thijs_replay: register not replayable"); return(false); }
+    if(reg == BQ51_MAILBOX) { mask &= ~(BQ51_MAILBOX_SEND_bits | BQ51_MAILBOX_ERR_bits | BQ51_MAILBOX_FOD_S_bits); } // (never replay a packet, ERR is read-only and FOD_S must be 0)
+    _value[reg - BQ51_MAILBOX] = (_value[reg - BQ51_MAILBOX] & ~mask) | (newValue & mask);
+    _mask[reg - BQ51_MAILBOX] |= mask;
+    return(true);
+  }
+  /**
+   * set one or more fields of the same register, like: setFields(BQ51_FOD_RO_field::with(3) | BQ51_FOD_RS_field::with(BQ51_RS_FOD_2x))
+   * @param fields the (combined) field values (see BQ51_fieldWrite)
+   */
+  template<uint8_t REG>
+  void setFields(BQ51_fieldWrite<REG> fields) { setBits(REG, fields.value, fields.mask); }
+  /**
+   * set a single field, like: setField<BQ51_FOD_RO_field>(3)
+   * @param newVal field value (not shifted)
+   */
+  template<class FIELD>
+  void setField(uint8_t newVal) { setBits(FIELD::reg, FIELD::encode(newVal), FIELD::mask); }
+
+  //// (the most common ones, for convenience)
+  void setFOD_RAM(uint8_t newVal) { setBits(BQ51_FOD_RAM, newVal, 0xFF); }
+  void setUSER_HEADER(uint8_t newVal) { setBits(BQ51_USER_HEADER_RAM, newVal, 0xFF); }
+
+  /**
+   * read the telemetry and the output registers in 1 burst read, and replay the desired state (1 burst write) if the device doesn't match it
+   * @param readBuff BQ51_telemetry struct reference to put the telemetry in (see BQ51_thijs::readTelemetry())
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it read (and if needed, wrote) successfully
+   */
+  BQ51_ERR_RETURN_TYPE update(BQ51_telemetry& readBuff) {
+    bool withMODE_IND = includeMODE_IND && !BQ51_isBQ51021(_device);
+    uint8_t rawBuff[BQ51_MODE_IND - BQ51_MAILBOX + 1]; // 0xE0 ~ 0xEF (only up to 0xE8 is read without MODE_IND)
+    uint8_t bytesToRead = withMODE_IND ? sizeof(rawBuff) : (BQ51_REC_PWR_STATUS_RAM - BQ51_MAILBOX + 1);
+    BQ51_ERR_RETURN_TYPE err = _device.requestReadBytes(BQ51_MAILBOX, rawBuff, bytesToRead);  transactions++;
+    if(!_device._errGood(err)) { readErrors++; return(err); }
+    _device._parseTelemetry(readBuff, &rawBuff[BQ51_VRECT_STATUS_RAM - BQ51_MAILBOX], withMODE_IND);
+    if(readBuff.VRECT < BQ51_VRECT_UVLO_raw) { _device.shadowInvalidate(true); return(err); } // (held in reset, writing now would be lost)
+    bool matches = true;
+    for(uint8_t i=0; i<BQ51_REPLAY_SIZE; i++) {
+      _device._shadowStore(BQ51_MAILBOX + i, rawBuff[i]);
+      if((rawBuff[i] & _mask[i]) != (_value[i] & _mask[i])) { matches = false; }
+    }
+    if(matches) { return(err); }
+    return(_write(rawBuff));
+  }
+
+  /**
+   * write the desired state right away (1 burst write, no read). Bits that aren't part of the desired state
+   *  come from the shadow copy (if BQ51_useShadowCache is defined and valid), otherwise from the reset defaults.
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully
+   */
+  BQ51_ERR_RETURN_TYPE apply() {
+    uint8_t current[BQ51_REPLAY_SIZE] = {BQ51_MAILBOX_default, 0, 0}; // (what the registers hold after a reset)
+    for(uint8_t i=0; i<BQ51_REPLAY_SIZE; i++) { _device._shadowGet(BQ51_MAILBOX + i, current[i]); }
+    return(_write(current));
+  }
+
+  private:
+  DEVICE& _device;
+  uint8_t _value[BQ51_REPLAY_SIZE]; // desired values (of the bits in _mask)
+  uint8_t _mask[BQ51_REPLAY_SIZE];  // bits that are part of the desired state
+
+  /**
+   * (private) write the desired state over the current values, from the first to the last register that has desired bits (1 burst write, see BQ51_thijs_batch)
+   * @param current current values of 0xE0 ~ 0xE2
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote successfully (BQ51_ERR_GOOD if there is nothing to write)
+   */
+  BQ51_ERR_RETURN_TYPE _write(const uint8_t current[]) {
+    uint8_t first = 0xFF, last = 0;
+    for(uint8_t i=0; i<BQ51_REPLAY_SIZE; i++) { if(_mask[i]) { if(first == 0xFF) { first = i; } last = i; } }
+    if(first == 0xFF) { return(BQ51_ERR_GOOD); } // nothing to replay
+    BQ51_thijs_batch batch(_device);
+    for(uint8_t i=first; i<=last; i++) { // (whole registers, including the ones in between that have no desired bits, so the batch doesn't read them again)
+      uint8_t value = (current[i] & ~_mask[i]) | (_value[i] & _mask[i]);
+      if(i == 0) { value |= BQ51_MAILBOX_SEND_bits; } // don't trigger a packet
+      batch.setRegister(BQ51_MAILBOX + i, value);
+    }
+    BQ51_ERR_RETURN_TYPE err = batch.commit();  transactions += batch.transactions;
+    if(!_device._errGood(err)) { writeErrors++;  return(err); }
+    replays++;
+    return(err);
+  }
+};
+
+typedef BQ51_thijs_replayFor<BQ51_thijs> BQ51_thijs_replay;
+
+#endif // BQ51_thijs_replay_h
@@ -0,0 +1,190 @@
+
+/*
+an add-on for BQ51_thijs, for sampling telemetry at a fixed rate into a lock-free ring buffer
+The sampler reads the telemetry (1 burst read, see BQ51_thijs::readTelemetry()) and pushes a timestamped record into a
+ single-producer/single-consumer ring buffer, which the application can drain in batches whenever it's convenient.
+
+There are 2 ways to drive the sampler:
+- call sample() from something that already runs at a fixed rate, like an RTOS task using vTaskDelayUntil() (or a timer-triggered task)
+- call poll() as often as possible (from loop()), it keeps its own schedule (based on micros()), without drifting
+The producer (sample()/poll()) and the consumer (drain()) may run in different tasks/contexts, as long as there is only one of each.
+NOTE: don't call sample() from an actual timer ISR, the (blocking) I2C functions are not meant to be used from an interrupt.
+*/
+
+#ifndef BQ51_thijs_sampler_h
+#define BQ51_thijs_sampler_h
+
+#include "BQ51_thijs.h"
+
+/**
+ * lock-free single-producer/single-consumer ring buffer with a compile-time capacity
+ * push() may only be called from one context, pop()/popBatch() only from one (other) context.
+ * @tparam T type of the items
+ * @tparam capacity max number of items, must be a power of 2 (max 128 on AVR, as the indices are single bytes there)
+ */
+template<typename T, uint16_t capacity>
+class BQ51_SPSCring
+{
+  #if defined(__AVR__)
+    typedef uint8_t _index_t; // (8bit accesses are atomic on AVR, 16bit ones are not)
+  #else
+    typedef uint16_t _index_t;
+  #endif
+  static_assert((capacity >= 2) && ((capacity & (capacity-1)) == 0), "BQ51_SPSCring capacity must be a power of 2");
+  static_assert(capacity <= ((_index_t)(~0) / 2 + 1), "BQ51_SPSCring capacity too large for the index type");
+
+  T _buffer[capacity];
+  _index_t _head = 0; // free-running write counter (only written by the producer)
+  _index_t _tail = 0; // free-running read counter (only written by the consumer)
+
+  static inline _index_t _loadAcquire(const _index_t& index) {
+    #if defined(__AVR__) || defined(__MSP430__) // single core, and the index accesses are atomic: a compiler barrier is enough
+      _index_t retVal = *((volatile const _index_t*)&index);
+      __asm__ __volatile__("" ::: "memory");
+      return(retVal);
+    #else
+      return(__atomic_load_n(&index, __ATOMIC_ACQUIRE));
+    #endif
+  }
+  static inline void _storeRelease(_index_t& index, _index_t newVal) {
+    #if defined(__AVR__) || defined(__MSP430__)
+      __asm__ __volatile__("" ::: "memory");
+      *((volatile _index_t*)&index) = newVal;
+    #else
+      __atomic_store_n(&index, newVal, __ATOMIC_RELEASE);
+    #endif
+  }
+
+  public:
+  /**
+   * (producer only) add an item
+   * @param item the item to copy into the buffer
+   * @return false if the buffer is full (the item is not added)
+   */
+  bool push(const T& item) {
+    _index_t head = _head; // (only the producer writes _head, so no need for atomics here)
+    if((_index_t)(head - _loadAcquire(_tail)) >= capacity) { return(false); }
+    _buffer[head & (capacity-1)] = item;
+    _storeRelease(_head, head+1);
+    return(true);
+  }
+
+  /**
+   * (consumer only) remove the oldest item
+   * @param item reference to copy the item into
+   * @return false if the buffer is empty
+   */
+  bool pop(T& item) { return(popBatch(&item, 1) == 1); }
+
+  /**
+   * (consumer only) remove up to maxItems of the oldest items at once
+   * @param items array to copy the items into
+   * @param maxItems size of the array
+   * @return number of items copied
+   */
+  uint16_t popBatch(T items[], uint16_t maxItems) {
+    _index_t tail = _tail;
+    _index_t available = _loadAcquire(_head) - tail;
+    uint16_t count = (available < maxItems) ? available : maxItems;
+    for(uint16_t i=0; i<count; i++) { items[i] = _buffer[(_index_t)(tail + i) & (capacity-1)]; }
+    _storeRelease(_tail, tail + count);
+    return(count);
+  }
+
+  /**
+   * @return number of items in the buffer (only exact when called from the producer or consumer)
+   */
+  uint16_t size() const { return((_index_t)(_loadAcquire(_head) - _loadAcquire(_tail))); }
+  bool empty() const { return(size() == 0); }
+  static uint16_t maxSize() { return(capacity); }
+};
+
+
+/**
+ * a single (compact) telemetry sample, see BQ51_telemetry for the meaning of the raw values
+ */
+struct BQ51_sample {
+  uint32_t timestamp_us; // micros() right before the read started
+  uint8_t VRECT;    // raw, LSB = 46mV (BQ51_VOLT_SCALAR_mV)
+  uint8_t VOUT;     // raw, LSB = 46mV (BQ51_VOLT_SCALAR_mV)
+  uint8_t REC_PWR;  // raw, LSB = 39mW (BQ51_WATT_SCALAR_mW)
+  uint8_t MODE_IND; // raw (only if includeMODE_IND, 0 otherwise)
+};
+
+/**
+ * samples the telemetry of a BQ51 at a fixed rate, into a BQ51_SPSCring
+ * @tparam capacity number of samples the ring buffer can hold (power of 2)
+ */
+template<uint16_t capacity>
+class BQ51_thijs_sampler
+{
+  public:
+  BQ51_SPSCring<BQ51_sample, capacity> buffer;
+  uint32_t period_us = 0;      // sample period (set by begin(), 0 while not started)
+  bool includeMODE_IND = false; // see BQ51_thijs::readTelemetry()
+  uint32_t dropped = 0;     // samples that were read, but didn't fit in the buffer (drain more often!)
+  uint32_t missed = 0;      // sample moments that were skipped, because poll() was called too late
+  uint32_t readErrors = 0;  // failed telemetry reads (not added to the buffer)
+
+  BQ51_thijs_sampler(BQ51_thijs& device) : _device(device) {}
+
+  /**
+   * start sampling (the first poll() will take a sample right away)
+   * @param samplePeriod_us period between samples in microseconds
+   * @param includeMODE_IND_ whether to also read the Mode Indicator register (see BQ51_thijs::readTelemetry())
+   * @return false if the sample period is 0 (the sampler is not started then)
+   */
+  bool begin(uint32_t samplePeriod_us, bool includeMODE_IND_=false) {
+    if(samplePeriod_us == 0) { BQ51debugPrint("BQ51_thijs_sampler period must not be 0!"); return(false); }
+    period_us = samplePeriod_us;
+    includeMODE_IND = includeMODE_IND_;
+    _nextDue = micros();
+    return(true);
+  }
+
+  /**
+   * take a sample right now (call this from a fixed-rate RTOS task, or use poll())
+   * @return whether the sample was read and added to the buffer
+   */
+  bool sample() {
+    BQ51_telemetry telemetry;
+    BQ51_sample newSample;
+    newSample.timestamp_us = micros();
+    if(!_device._errGood(_device.readTelemetry(telemetry, includeMODE_IND))) { readErrors++; return(false); }
+    newSample.VRECT = telemetry.VRECT;  newSample.VOUT = telemetry.VOUT;
+    newSample.REC_PWR = telemetry.REC_PWR;  newSample.MODE_IND = telemetry.MODE_IND;
+    if(!buffer.push(newSample)) { dropped++; return(false); }
+    return(true);
+  }
+
+  /**
+   * take a sample if it's time for one (call this as often as possible). The schedule is kept in absolute time, so it doesn't drift.
+   * @return whether a sample was taken (and added to the buffer)
+   */
+  bool poll() {
+    if(period_us == 0) { return(false); } // not started (see begin())
+    uint32_t now = micros();
+    if((int32_t)(now - _nextDue) < 0) { return(false); } // not time yet
+    _nextDue += period_us;
+    if((int32_t)(now - _nextDue) >= 0) { // more than a whole period late, skip the sample moments that were missed
+      uint32_t periodsLate = (now - _nextDue) / period_us + 1;
+      missed += periodsLate;
+      _nextDue += periodsLate * period_us;
+    }
+    return(sample());
+  }
+
+  /**
+   * (consumer) retrieve the oldest samples from the buffer
+   * @param samples array to copy the samples into
+   * @param maxSamples size of the array
+   * @return number of samples copied
+   */
+  uint16_t drain(BQ51_sample samples[], uint16_t maxSamples) { return(buffer.popBatch(samples, maxSamples)); }
+
+  private:
+  BQ51_thijs& _device;
+  uint32_t _nextDue = 0;
+};
+
+#endif // BQ51_thijs_sampler_h
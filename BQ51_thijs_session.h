@@ -0,0 +1,200 @@
+/*
+an add-on for BQ51_thijs, for keeping track of power sessions (from the moment a TX starts powering the receiver, until it stops)
+Every time the receiver gets (re)powered, the 0xE0+ registers start out fresh, but nothing in BQ51_thijs keeps track of that.
+This class summarizes each session on the device itself, so only 1 small record per session has to be sent anywhere:
+- the RXID is read once at the start of a session (1 extra transaction) and cached, it is not read again until the next session.
+   (a session only starts once the RXID reads as something other than all 1's, see BQ51_thijs::poweredCheck())
+- REC_PWR is integrated over time (mW * ms, with the remainder carried over, like BQ51_thijs_headroom does) into energy_mJ
+- min/max/mean of V_RECT and V_OUT are updated incrementally (O(1) per sample). The means are kept as sums of the raw (46mV LSB) values,
+   so they are exact, and the sums stop growing after BQ51_SESSION_MAX_SAMPLES samples (the mean of the first ~16 million samples is still a good mean).
+- a session ends after endAfterMisses consecutive updates where V_RECT < V_UVLO (or the device doesn't respond, as it runs off V_RECT),
+   or when end() is called. At that point, the summary record is passed to the callback.
+update() takes 1 burst read (see BQ51_thijs::readTelemetry()). If the application already reads the telemetry (e.g. BQ51_thijs_sampler),
+ it can pass those readings to addSample() instead, which only touches the bus for the RXID at the start of a session.
+Everything is integer math, so it also works with BQ51_noFloat.
+BQ51_thijs_session takes any BQ51_thijs. BQ51_thijs_sessionFor<BQ51_thijs_variant<...>> takes a specific chip variant,
+ so the BQ51021 check (RXID) is resolved at compile time (see BQ51_thijs_variant).
+*/
+
+#ifndef BQ51_thijs_session_h
+#define BQ51_thijs_session_h
+
+#include "BQ51_thijs.h"
+
+#define BQ51_SESSION_MAX_SAMPLES  0x00FFFFFF // (255 * this still fits in a uint32_t sum)
+
+/**
+ * compact summary of 1 power session
+ */
+struct BQ51_sessionSummary {
+  uint8_t RXID[BQ51_RXID_size]; // (all 0's on the BQ51021, which doesn't have RXID registers)
+  uint16_t number;        // session counter (since the BQ51_thijs_session object was made)
+  uint32_t start_ms;      // millis() at the first powered sample
+  uint32_t duration_ms;   // time between the first and the last powered sample
+  uint32_t energy_mJ;     // REC_PWR integrated over the session
+  uint32_t samples;       // number of powered samples
+  uint16_t VRECTmin_mV, VRECTmax_mV, VRECTmean_mV;
+  uint16_t VOUTmin_mV, VOUTmax_mV, VOUTmean_mV;
+  uint16_t REC_PWRmax_mW; // peak received power
+};
+
+/**
+ * function to be called when a session ends
+ * @param summary the summary of the session that just ended
+ * @param arg the (user) argument that was passed to setCallback()
+ */
+typedef void (*BQ51_sessionCallback)(const BQ51_sessionSummary& summary, void* arg);
+
+/**
+ * power session tracker, with a cached RXID and per-session energy and voltage statistics
+ * @tparam DEVICE BQ51_thijs, or a BQ51_thijs_variant (see top)
+ */
+template<class DEVICE>
+class BQ51_thijs_sessionFor
+{
+  public:
+  uint8_t endAfterMisses = 2; // consecutive unpowered (or failed) updates that end a session (more than 1, so a single bus error doesn't split a session)
+  //// results (read-only):
+  bool active = false;        // whether a session is in progress
+  uint16_t sessions = 0;      // number of sessions that were started
+  uint32_t transactions = 0;  // number of I2C transactions issued
+  uint32_t readErrors = 0;    // failed telemetry/RXID reads
+
+  BQ51_thijs_sessionFor(DEVICE& device) : _device(device) { memset(&_summary, 0, sizeof(_summary)); }
+
+  /**
+   * set the function to be called when a session ends
+   * @param callback the function (or NULL to disable)
+   * @param arg (user) argument to pass along to the callback
+   */
+  void setCallback(BQ51_sessionCallback callback, void* arg=NULL) { _callback = callback; _callbackArg = arg; }
+
+  /**
+   * read the telemetry (1 burst read) and update the session. Call this periodically.
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it read successfully
+   */
+  BQ51_ERR_RETURN_TYPE update() {
+    BQ51_telemetry telemetry;
+    BQ51_ERR_RETURN_TYPE err = _device.readTelemetry(telemetry);  transactions++;
+    if(!_device._errGood(err)) { readErrors++;  _miss(); return(err); } // (the BQ51 runs off V_RECT, so no response may just mean no TX)
+    return(addSample(telemetry));
+  }
+
+  /**
+   * update the session with telemetry that was read elsewhere (only reads the RXID, at the start of a session)
+   * @param telemetry a (successful) telemetry reading
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether the RXID was read successfully (BQ51_ERR_GOOD if it didn't need to be read)
+   */
+  BQ51_ERR_RETURN_TYPE addSample(const BQ51_telemetry& telemetry) {
+    if(telemetry.VRECT < BQ51_VRECT_UVLO_raw) { _miss(); return(BQ51_ERR_GOOD); }
+    _misses = 0;
+    uint32_t now = millis();
+    if(!active) {
+      BQ51_ERR_RETURN_TYPE err = _start(now);
+      if(!active) { return(err); } // (RXID not readable (yet), try again at the next sample)
+    }
+    //// energy (time since the previous sample, at the power of this sample):
+    uint32_t dt_ms = now - _lastSample_ms; // (split into whole seconds (mW * s = mJ) and the rest (mW * ms = uJ), as the product overflows 32bits after ~7 minutes)
+    _summary.energy_mJ += (uint32_t)telemetry.REC_PWR_mW * (dt_ms / 1000);
+    _energyRemainder += (uint32_t)telemetry.REC_PWR_mW * (dt_ms % 1000);
+    _summary.energy_mJ += _energyRemainder / 1000;  _energyRemainder %= 1000;
+    _lastSample_ms = now;
+    _summary.duration_ms = now - _summary.start_ms;
+    //// statistics:
+    if(_summary.samples == 0) {
+      _VRECTmin = _VRECTmax = telemetry.VRECT;  _VOUTmin = _VOUTmax = telemetry.VOUT;
+    } else {
+      if(telemetry.VRECT < _VRECTmin) { _VRECTmin = telemetry.VRECT; }
+      if(telemetry.VRECT > _VRECTmax) { _VRECTmax = telemetry.VRECT; }
+      if(telemetry.VOUT < _VOUTmin) { _VOUTmin = telemetry.VOUT; }
+      if(telemetry.VOUT > _VOUTmax) { _VOUTmax = telemetry.VOUT; }
+    }
+    if(telemetry.REC_PWR_mW > _summary.REC_PWRmax_mW) { _summary.REC_PWRmax_mW = telemetry.REC_PWR_mW; }
+    if(_meanSamples < BQ51_SESSION_MAX_SAMPLES) { _VRECTsum += telemetry.VRECT;  _VOUTsum += telemetry.VOUT;  _meanSamples++; }
+    _summary.samples++;
+    return(BQ51_ERR_GOOD);
+  }
+
+  /**
+   * end the current session (if any) right now, and pass its summary to the callback (e.g. before going to sleep)
+   */
+  void end() {
+    if(!active) { return; }
+    active = false;
+    const BQ51_sessionSummary& finished = summary();
+    if(_callback != NULL) { _callback(finished, _callbackArg); }
+  }
+
+  /**
+   * @return the summary of the current session (so far), or of the last one if no session is active
+   */
+  const BQ51_sessionSummary& summary() {
+    _summary.VRECTmin_mV = _VRECTmin * BQ51_VOLT_SCALAR_mV;  _summary.VRECTmax_mV = _VRECTmax * BQ51_VOLT_SCALAR_mV;
+    _summary.VOUTmin_mV = _VOUTmin * BQ51_VOLT_SCALAR_mV;  _summary.VOUTmax_mV = _VOUTmax * BQ51_VOLT_SCALAR_mV;
+    _summary.VRECTmean_mV = _mean_mV(_VRECTsum);  _summary.VOUTmean_mV = _mean_mV(_VOUTsum);
+    return(_summary);
+  }
+
+  /**
+   * @return the RXID of the current (or last) session, cached at the start of the session
+   */
+  const uint8_t* RXID() const { return(_summary.RXID); }
+
+  private:
+  DEVICE& _device;
+  BQ51_sessionCallback _callback = NULL;
+  void* _callbackArg = NULL;
+  BQ51_sessionSummary _summary;
+  uint8_t _misses = 0;
+  uint32_t _lastSample_ms = 0;
+  uint32_t _energyRemainder = 0; // (microJoules) leftover of energy_mJ
+  uint8_t _VRECTmin = 0, _VRECTmax = 0, _VOUTmin = 0, _VOUTmax = 0; // (raw)
+  uint32_t _VRECTsum = 0, _VOUTsum = 0; // (raw) sums for the means
+  uint32_t _meanSamples = 0; // number of samples in the sums
+
+  /**
+   * (private) start a new session: read (and cache) the RXID and reset the statistics
+   * @param now millis() of the first sample
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether the RXID was read successfully
+   */
+  BQ51_ERR_RETURN_TYPE _start(uint32_t now) {
+    uint8_t RXID[BQ51_RXID_size] = {0};
+    BQ51_ERR_RETURN_TYPE err = BQ51_ERR_GOOD;
+    if(!BQ51_isBQ51021(_device)) { // (the BQ51021 doesn't have RXID registers)
+      err = _device.requestReadBytes(BQ51_RXID_READBACK, RXID, BQ51_RXID_size);  transactions++; // (like getRXID(), which the BQ51021 variant doesn't have)
+      if(!_device._errGood(err)) { readErrors++; return(err); }
+      bool allOnes = true; for(uint8_t i=0; i<BQ51_RXID_size; i++) { allOnes &= (RXID[i] == 0xFF); }
+      if(allOnes) { return(err); } // the output registers are still held in reset
+    }
+    memset(&_summary, 0, sizeof(_summary));
+    memcpy(_summary.RXID, RXID, BQ51_RXID_size);
+    _summary.number = sessions;  sessions++;
+    _summary.start_ms = now;  _lastSample_ms = now;
+    _energyRemainder = 0;  _VRECTsum = 0;  _VOUTsum = 0;  _meanSamples = 0;
+    active = true;
+    return(err);
+  }
+
+  /**
+   * (private) count an unpowered (or failed) update, and end the session after endAfterMisses of them
+   */
+  void _miss() {
+    if(!active) { return; }
+    _misses++;
+    if(_misses >= endAfterMisses) { _misses = 0;  end(); }
+  }
+
+  /**
+   * (private) calculate a mean (without overflowing, as the sum * 46 may not fit in 32bits)
+   * @param sum sum of _meanSamples raw values
+   * @return the mean in milliVolts
+   */
+  uint16_t _mean_mV(uint32_t sum) const {
+    if(_meanSamples == 0) { return(0); }
+    return(((sum / _meanSamples) * BQ51_VOLT_SCALAR_mV) + (((sum % _meanSamples) * BQ51_VOLT_SCALAR_mV) / _meanSamples));
+  }
+};
+
+typedef BQ51_thijs_sessionFor<BQ51_thijs> BQ51_thijs_session;
+
+#endif // BQ51_thijs_session_h
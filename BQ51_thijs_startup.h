@@ -0,0 +1,99 @@
+/*
+an add-on for BQ51_thijs, for bringing a receiver up as fast as possible (instead of init() + connectionCheck() + poweredCheck() + setters + delay())
+The usual sequence takes a 2-byte read, a 6-byte RXID read, a 1-byte V_RECT read, a few (read-modify-)writes, and then a fixed delay
+ (a few hundred milliseconds) before V_OUT can be trusted. begin() does:
+1. 1 burst read of 0xE0 ~ 0xE3 (MAILBOX, FOD_RAM, USER_HEADER_RAM, V_RECT), which checks the connection (ACK)
+    and the power (V_RECT >= V_UVLO) at once, and also gives the current value of the writable output registers.
+2. the configuration that was staged in 'config' (a BQ51_thijs_batch, see BQ51_thijs_batch.h) is written in 1~3 burst writes.
+    The (partially) staged output registers are completed with the values from step 1, so that takes no extra reads.
+3. V_OUT is polled every pollInterval_us until settleSamples consecutive samples are within settleTolerance_mV of each other,
+    or until deadline_ms has passed (in which case begin() still succeeds, but 'settled' is false).
+If the device is not powered (yet), step 2 and 3 are skipped (the output registers are held in reset anyway), and the configuration stays
+ staged, so begin() can simply be called again later.
+*/
+
+#ifndef BQ51_thijs_startup_h
+#define BQ51_thijs_startup_h
+
+#include "BQ51_thijs.h"
+#include "BQ51_thijs_batch.h"
+
+/**
+ * fast bring-up: merged probe read, burst config writes and V_OUT settle detection (instead of fixed delays)
+ */
+class BQ51_thijs_startup
+{
+  public:
+  BQ51_thijs_batch config; // stage the desired configuration in here before calling begin()
+  uint16_t settleTolerance_mV = BQ51_VOLT_SCALAR_mV; // V_OUT is settled when settleSamples consecutive samples are within this of the first one (1 LSB by default)
+  uint8_t settleSamples = 4;      // (see settleTolerance_mV) NOTE: (settleSamples-1) * pollInterval_us should be long enough that a ramp moves more than the tolerance in that time
+  uint16_t pollInterval_us = 5000; // time between V_OUT samples
+  uint16_t deadline_ms = 500;      // give up waiting for V_OUT to settle after this long
+  //// results (read-only):
+  bool powered = false;         // whether V_RECT >= V_UVLO at the probe read
+  uint16_t VRECT_mV = 0;        // V_RECT at the probe read
+  uint16_t VOUT_mV = 0;         // V_OUT at the end of begin() (the settled value, if settled)
+  bool settled = false;         // whether V_OUT settled before the deadline
+  uint32_t settleTime_us = 0;   // how long V_OUT took to settle (or the time until the deadline)
+  uint32_t duration_us = 0;     // how long begin() took in total
+  uint16_t transactions = 0;    // number of I2C transactions begin() took
+
+  BQ51_thijs_startup(BQ51_thijs& device) : config(device), _device(device) {}
+
+  /**
+   * probe the device, write the staged configuration and wait for V_OUT to settle (see top). Call init() first.
+   * @return (bool or esp_err_t or i2c_status_e, see on defines at top) whether it read/wrote successfully (NOTE: check 'powered' and 'settled' as well)
+   */
+  BQ51_ERR_RETURN_TYPE begin() {
+    uint32_t startMicros = micros();
+    transactions = 0;  powered = false;  settled = false;  VOUT_mV = 0;  settleTime_us = 0;
+    uint8_t probe[BQ51_VRECT_STATUS_RAM - BQ51_MAILBOX + 1]; // 0xE0 ~ 0xE3 (the registers are contiguous, so the device auto-increments)
+    BQ51_ERR_RETURN_TYPE err = _device.requestReadBytes(BQ51_MAILBOX, probe, sizeof(probe));  transactions++;
+    if(!_device._errGood(err)) { duration_us = micros() - startMicros;  return(err); } // not connected
+    VRECT_mV = probe[BQ51_VRECT_STATUS_RAM - BQ51_MAILBOX] * BQ51_VOLT_SCALAR_mV;
+    powered = (probe[BQ51_VRECT_STATUS_RAM - BQ51_MAILBOX] >= BQ51_VRECT_UVLO_raw);
+    if(!powered) { _device.shadowInvalidate(true);  duration_us = micros() - startMicros;  return(err); } // (the config stays staged, for the next attempt)
+    for(uint8_t reg=BQ51_MAILBOX; reg<=BQ51_USER_HEADER_RAM; reg++) { _device._shadowStore(reg, probe[reg - BQ51_MAILBOX]); }
+    _completeFromProbe(probe);
+    err = config.commit();  transactions += config.transactions;
+    if(!_device._errGood(err)) { duration_us = micros() - startMicros;  return(err); }
+    //// wait for V_OUT to settle:
+    uint32_t settleStart = micros();
+    uint8_t VOUT = 0, anchor = 0, stableCount = 0;
+    while(true) {
+      err = _device.getVOUT(VOUT);  transactions++;
+      if(!_device._errGood(err)) { break; }
+      uint8_t difference = (VOUT > anchor) ? (VOUT - anchor) : (anchor - VOUT);
+      if((stableCount > 0) && (((uint16_t)difference * BQ51_VOLT_SCALAR_mV) <= settleTolerance_mV)) { stableCount++; }
+      else { anchor = VOUT;  stableCount = 1; } // (compared to the first sample of the window, so a slow ramp doesn't count as settled)
+      if(stableCount >= settleSamples) { settled = true;  break; }
+      if((micros() - settleStart) >= ((uint32_t)deadline_ms * 1000)) { break; }
+      delayMicroseconds(pollInterval_us);
+    }
+    VOUT_mV = VOUT * BQ51_VOLT_SCALAR_mV;
+    settleTime_us = micros() - settleStart;
+    duration_us = micros() - startMicros;
+    return(err);
+  }
+
+  private:
+  BQ51_thijs& _device;
+
+  /**
+   * (private) fill in the unstaged bits of the staged output registers (and the ones in between) with the probed values,
+   *  so the commit doesn't need to read them again
+   * @param probe the values of 0xE0 ~ 0xE3
+   */
+  void _completeFromProbe(const uint8_t probe[]) {
+    uint8_t first = 0xFF, last = 0;
+    for(uint8_t reg=BQ51_MAILBOX; reg<=BQ51_USER_HEADER_RAM; reg++) { if(config.stagedMask(reg)) { if(first == 0xFF) { first = reg; } last = reg; } }
+    if(first == 0xFF) { return; } // nothing staged in this range
+    for(uint8_t reg=first; reg<=last; reg++) {
+      uint8_t value = probe[reg - BQ51_MAILBOX];
+      if(reg == BQ51_MAILBOX) { value |= BQ51_MAILBOX_SEND_bits; } // (never trigger a packet, unless that was staged explicitly (then that bit isn't touched here))
+      config.setBits(reg, value, ~config.stagedMask(reg));
+    }
+  }
+};
+
+#endif // BQ51_thijs_startup_h
@@ -2,21 +2,39 @@
 #ifndef _BQ51_thijs_base_h
 #define _BQ51_thijs_base_h
 
-#include "Arduino.h" // always import Arduino.h
+#if defined(BQ51_useHostSim) || defined(BQ51_useLinuxI2C)
+  #include "_BQ51_thijs_host.h" // (a host has no Arduino.h, this provides the few things the library needs)
+#else
+  #include "Arduino.h" // always import Arduino.h
+#endif
 
 #include "BQ51_thijs.h" // (i feel like this constitutes a cicular dependency, but the compiler doesn't seem to mind)
 
 
-#ifndef BQ51_useWireLib // (note: ifNdef!) if this has been defined by the user, then don't do all this manual stuff
+//#define BQ51_useHostSim  // run on a (Linux/Windows/Mac) host, against a simulated BQ51 (see _BQ51_thijs_sim.h), for benchmarking/testing without a board
+//#define BQ51_useLinuxI2C  // run on Linux (e.g. a Raspberry Pi), through the i2c-dev interface (/dev/i2c-N)
+
+#if defined(BQ51_useHostSim)
+  #include "_BQ51_thijs_sim.h"
+#elif defined(BQ51_useLinuxI2C)
+  #include <linux/i2c.h>
+  #include <linux/i2c-dev.h>
+  #include <sys/ioctl.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <errno.h>
+#elif !defined(BQ51_useWireLib) // (note: ifNdef!) if this has been defined by the user, then don't do all this manual stuff
   #if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) // TODO: test 328p processor defines! (also, this code may be functional on other AVR hw as well?)
     // nothing to import, all ATMega328P registers are imported by default
   #elif defined(ARDUINO_ARCH_ESP32)
     #include "driver/i2c.h"
   #elif defined(__MSP430FR2355__) //TBD: determine other MSP430 compatibility: || defined(ENERGIA_ARCH_MSP430) || defined(__MSP430__)
     #include <msp430.h>
-    extern "C" {
-      #include "twi.h"
-    }
+    #ifndef BQ51_MSP430_direct
+      extern "C" {
+        #include "twi.h"
+      }
+    #endif
   #elif defined(ARDUINO_ARCH_STM32)
     extern "C" {
       #include "utility/twi.h"
@@ -30,6 +48,13 @@
 #ifdef BQ51_useWireLib // note: this ifdef check is done after the ifndef, so the compiler gets a chance to define it anyway
   #include <Wire.h>
   // note: check the defined BUFFER_LENGTH in Wire.h for the max transmission length (on many platforms)
+  #ifndef BQ51_WIRE_REPEATED_START // whether Wire.endTransmission(false) (no STOP, so the next requestFrom() uses a repeated start) works on this core
+    #if defined(ENERGIA) || defined(__MSP430__) // the Energia (MSP430) twi layer can't do repeated starts
+      #define BQ51_WIRE_REPEATED_START  0
+    #else // (AVR, ESP32, ESP8266, STM32, SAMD, RP2040, nRF52, etc. all can)
+      #define BQ51_WIRE_REPEATED_START  1
+    #endif
+  #endif
 #endif
 
 
@@ -37,6 +62,9 @@
   #define BQ51_ERR_RETURN_TYPE_default  bool
   #ifdef BQ51_useWireLib
     #define BQ51_ERR_RETURN_TYPE  BQ51_ERR_RETURN_TYPE_default
+  #elif defined(BQ51_useLinuxI2C) // on Linux, errors are errno values (0 means no error)
+    #define BQ51_ERR_RETURN_TYPE  int
+    #define BQ51_return_errno // to let the code below know that the return type is an errno value
   #elif defined(ARDUINO_ARCH_ESP32) // the ESP32 likes to spit out esp_err_t for most things
     #define BQ51_ERR_RETURN_TYPE  esp_err_t
     #define BQ51_return_esp_err_t   // to let the code below know that the return type is an esp_err_t
@@ -48,6 +76,242 @@
   #endif
 #endif
 
+#ifndef BQ51_ERR_GOOD // the 'no error' value of BQ51_ERR_RETURN_TYPE (for functions that don't touch the bus, like cached reads)
+  #if defined(BQ51_return_esp_err_t)
+    #define BQ51_ERR_GOOD  ESP_OK
+  #elif defined(BQ51_return_i2c_status_e)
+    #define BQ51_ERR_GOOD  I2C_OK
+  #elif defined(BQ51_return_errno)
+    #define BQ51_ERR_GOOD  0
+  #else
+    #define BQ51_ERR_GOOD  true
+  #endif
+#endif
+
+//#define BQ51_useAsync  // enable the non-blocking requestReadBytesAsync() / writeBytesAsync() functions (only on platforms that have an implementation for it)
+#ifdef BQ51_useAsync
+  #ifndef BQ51_TWI_ASYNC_TIMEOUT_MS
+    #define BQ51_TWI_ASYNC_TIMEOUT_MS  10 // (AVR only) max duration of an asynchronous transaction, before the peripheral is reset
+  #endif
+  #ifndef BQ51_STM32_ASYNC_TIMEOUT_MS
+    #define BQ51_STM32_ASYNC_TIMEOUT_MS  10 // (STM32 only) max duration of an asynchronous transaction, before the peripheral is reset
+  #endif
+  #ifndef BQ51_STM32_ASYNC_HANDLES
+    #define BQ51_STM32_ASYNC_HANDLES  4 // (STM32 only) max number of I2C peripherals with an asynchronous transaction in progress at the same time
+  #endif
+  /**
+   * function to be called when an asynchronous transaction is done
+   * @param arg the (user) argument that was passed along with the transaction
+   * @param err (bool or esp_err_t or i2c_status_e, see on defines at top) whether it wrote/read successfully
+   */
+  typedef void (*BQ51_asyncCallback)(void* arg, BQ51_ERR_RETURN_TYPE err);
+#endif
+
+//#define BQ51_useInstrumentation  // count transactions/bytes/time per register, errors per error code and a latency histogram (see BQ51_instrumentation)
+//#define BQ51_useTrace  // record the last BQ51_TRACE_LENGTH transactions in a ring buffer (see BQ51_trace)
+#if defined(BQ51_useInstrumentation) || defined(BQ51_useTrace)
+  #ifndef BQ51_INSTR_CLOCK
+    #define BQ51_INSTR_CLOCK()  micros() // clock used to time transactions (define it as something finer, like a cycle counter, if you have one)
+  #endif
+  enum BQ51_TRANSACTION_ENUM : uint8_t { // type of transaction (for instrumentation and trace)
+    BQ51_TRANSACTION_read     = 0, // requestReadBytes()
+    BQ51_TRANSACTION_onlyRead = 1, // onlyReadBytes()
+    BQ51_TRANSACTION_write    = 2  // writeBytes()
+  };
+#endif
+
+#ifdef BQ51_useInstrumentation
+  #ifndef BQ51_INSTR_ERR_SLOTS
+    #define BQ51_INSTR_ERR_SLOTS  6 // number of different error codes that are counted seperately (any more end up in otherErrors)
+  #endif
+  #define BQ51_INSTR_HIST_BUCKETS  16 // latency histogram bucket i counts durations of [2^i, 2^(i+1)) clock ticks (bucket 0 also counts 0, the last one everything above)
+  #define BQ51_INSTR_REG_misc      (2 + (BQ51_RXID_READBACK + BQ51_RXID_size - BQ51_MAILBOX)) // index for registers outside of 0x01~0x02 and 0xE0~0xFA
+  #define BQ51_INSTR_REG_onlyRead  (BQ51_INSTR_REG_misc + 1) // index for onlyReadBytes() (which doesn't know the register)
+  #define BQ51_INSTR_REG_count     (BQ51_INSTR_REG_onlyRead + 1)
+
+  /**
+   * transaction statistics, recorded by the (instrumented) requestReadBytes(), onlyReadBytes() and writeBytes() in BQ51_thijs
+   */
+  struct BQ51_instrumentation {
+    struct {
+      uint32_t reads;  // read transactions starting at this register
+      uint32_t writes; // write transactions starting at this register
+      uint32_t bytes;  // data bytes read/written (not counting the register/address bytes)
+      uint32_t time;   // total duration (in BQ51_INSTR_CLOCK ticks)
+    } perReg[BQ51_INSTR_REG_count]; // see regIndex()
+    struct {
+      BQ51_ERR_RETURN_TYPE code;
+      uint32_t count;
+    } errors[BQ51_INSTR_ERR_SLOTS]; // counts per error code (in order of first occurrence)
+    uint8_t errorCodes;   // number of used errors[] slots
+    uint32_t otherErrors; // errors that didn't fit in errors[]
+    uint32_t readHistogram[BQ51_INSTR_HIST_BUCKETS];  // latency histogram of requestReadBytes() and onlyReadBytes()
+    uint32_t writeHistogram[BQ51_INSTR_HIST_BUCKETS]; // latency histogram of writeBytes()
+
+    BQ51_instrumentation() { reset(); }
+
+    /**
+     * clear all statistics
+     */
+    void reset() {
+      memset(perReg, 0, sizeof(perReg));  memset(errors, 0, sizeof(errors));
+      errorCodes = 0;  otherErrors = 0;
+      memset(readHistogram, 0, sizeof(readHistogram));  memset(writeHistogram, 0, sizeof(writeHistogram));
+    }
+
+    /**
+     * @param reg register byte (see list of defines at top)
+     * @return index in perReg[] (0~1 for 0x01~0x02, 2~28 for 0xE0~0xFA, BQ51_INSTR_REG_misc for anything else)
+     */
+    static uint8_t regIndex(uint8_t reg) {
+      if((reg >= BQ51_VO_REG) && (reg <= BQ51_IO_REG)) { return(reg - BQ51_VO_REG); }
+      if((reg >= BQ51_MAILBOX) && (reg < (BQ51_RXID_READBACK + BQ51_RXID_size))) { return(2 + reg - BQ51_MAILBOX); }
+      return(BQ51_INSTR_REG_misc);
+    }
+
+    /**
+     * @param duration transaction duration in BQ51_INSTR_CLOCK ticks
+     * @return histogram bucket index (floor(log2(duration)), clamped)
+     */
+    static uint8_t histogramBucket(uint32_t duration) {
+      uint8_t bucket = 0;
+      while((duration >>= 1) && (bucket < (BQ51_INSTR_HIST_BUCKETS-1))) { bucket++; }
+      return(bucket);
+    }
+
+    /**
+     * (internal) record a transaction
+     * @param isWrite whether it was a write (or a read)
+     * @param index perReg[] index (see regIndex())
+     * @param length number of data bytes
+     * @param err the result
+     * @param good whether err means success
+     * @param duration duration in BQ51_INSTR_CLOCK ticks
+     */
+    void record(bool isWrite, uint8_t index, uint8_t length, BQ51_ERR_RETURN_TYPE err, bool good, uint32_t duration) {
+      if(isWrite) { perReg[index].writes++;  writeHistogram[histogramBucket(duration)]++; }
+      else { perReg[index].reads++;  readHistogram[histogramBucket(duration)]++; }
+      perReg[index].time += duration;
+      if(good) { perReg[index].bytes += length;  return; }
+      for(uint8_t i=0; i<errorCodes; i++) { if(errors[i].code == err) { errors[i].count++;  return; } }
+      if(errorCodes < BQ51_INSTR_ERR_SLOTS) { errors[errorCodes].code = err;  errors[errorCodes].count = 1;  errorCodes++; }
+      else { otherErrors++; }
+    }
+  };
+#endif
+
+#ifdef BQ51_useTrace
+  #ifndef BQ51_TRACE_LENGTH
+    #define BQ51_TRACE_LENGTH  32 // number of transactions kept in the trace (power of 2)
+  #endif
+  #ifndef BQ51_TRACE_DATA_BYTES
+    #define BQ51_TRACE_DATA_BYTES  4 // number of data bytes kept per transaction
+  #endif
+  #define BQ51_TRACE_ERR_bit  0b10000000 // (BQ51_traceEntry::flags) the transaction failed
+  #define BQ51_TRACE_DIR_bits 0b00000011 // (BQ51_traceEntry::flags) BQ51_TRANSACTION_ENUM
+
+  /**
+   * a single recorded transaction
+   */
+  struct BQ51_traceEntry {
+    uint32_t timestamp; // BQ51_INSTR_CLOCK() at the start of the transaction
+    uint16_t duration;  // in BQ51_INSTR_CLOCK ticks (saturates at 65535)
+    uint8_t flags;      // BQ51_TRACE_DIR_bits and BQ51_TRACE_ERR_bit
+    uint8_t reg;        // register byte (0 for onlyReadBytes(), which doesn't know the register)
+    uint8_t length;     // number of data bytes (of which the first BQ51_TRACE_DATA_BYTES are in data[])
+    int16_t result;     // the BQ51_ERR_RETURN_TYPE, cast to an int16_t
+    uint8_t data[BQ51_TRACE_DATA_BYTES]; // the first bytes read/written (only for successful transactions, the rest is 0)
+  };
+
+  /**
+   * ring buffer of the most recent transactions (the oldest ones are overwritten), recorded by the (wrapped) I2C functions in BQ51_thijs.
+   * The trace can be exported as CSV or as a compact binary format, for offline timing analysis:
+   * CSV: a header line, then one line per transaction: timestamp,duration,direction(R/O/W),register,length,result,ok(1/0),data bytes (space seperated, decimal)
+   * binary (little-endian): "BQ51T", version (1), BQ51_TRACE_DATA_BYTES, entry count (uint16), total recorded (uint32),
+   *  then per entry: timestamp (uint32), duration (uint16), flags, reg, length, result (int16), data[BQ51_TRACE_DATA_BYTES]
+   */
+  struct BQ51_trace {
+    static_assert((BQ51_TRACE_LENGTH & (BQ51_TRACE_LENGTH-1)) == 0, "BQ51_TRACE_LENGTH must be a power of 2");
+    BQ51_traceEntry entries[BQ51_TRACE_LENGTH];
+    uint32_t total = 0; // number of transactions recorded since the last clear() (may be more than the buffer holds)
+
+    /**
+     * empty the trace
+     */
+    void clear() { total = 0; }
+
+    /**
+     * @return number of entries in the buffer
+     */
+    uint16_t count() const { return((total < BQ51_TRACE_LENGTH) ? total : BQ51_TRACE_LENGTH); }
+
+    /**
+     * @param i 0 for the oldest entry in the buffer, count()-1 for the newest
+     * @return the entry
+     */
+    const BQ51_traceEntry& operator[](uint16_t i) const { return(entries[(total - count() + i) & (BQ51_TRACE_LENGTH-1)]); }
+
+    /**
+     * (internal) record a transaction
+     */
+    void record(uint32_t timestamp, uint32_t duration, uint8_t direction, uint8_t reg, const uint8_t data[], uint8_t length, BQ51_ERR_RETURN_TYPE err, bool good) {
+      BQ51_traceEntry& entry = entries[(total++) & (BQ51_TRACE_LENGTH-1)];
+      entry.timestamp = timestamp;
+      entry.duration = (duration > 0xFFFF) ? 0xFFFF : duration;
+      entry.flags = direction | (good ? 0 : BQ51_TRACE_ERR_bit);
+      entry.reg = reg;  entry.length = length;
+      entry.result = (int16_t)err;
+      memset(entry.data, 0, BQ51_TRACE_DATA_BYTES); // (the slot is reused, and dumpBinary() exports all of data[])
+      if(good) { memcpy(entry.data, data, (length < BQ51_TRACE_DATA_BYTES) ? length : BQ51_TRACE_DATA_BYTES); }
+    }
+
+    /**
+     * write the trace as CSV (oldest first)
+     * @param out anything with print(const char*), print(unsigned long), print(long) and println() (like Serial)
+     */
+    template<class STREAM>
+    void dumpCSV(STREAM& out) const {
+      out.print("timestamp,duration,direction,register,length,result,ok,data"); out.println();
+      for(uint16_t i=0; i<count(); i++) {
+        const BQ51_traceEntry& entry = (*this)[i];
+        out.print((unsigned long)entry.timestamp); out.print(",");
+        out.print((unsigned long)entry.duration); out.print(",");
+        uint8_t direction = entry.flags & BQ51_TRACE_DIR_bits;
+        out.print((direction == BQ51_TRANSACTION_write) ? "W," : ((direction == BQ51_TRANSACTION_onlyRead) ? "O," : "R,"));
+        out.print((unsigned long)entry.reg); out.print(",");
+        out.print((unsigned long)entry.length); out.print(",");
+        out.print((long)entry.result); out.print(",");
+        bool good = !(entry.flags & BQ51_TRACE_ERR_bit);
+        out.print(good ? "1," : "0,");
+        if(good) {
+          for(uint8_t j=0; (j<entry.length) && (j<BQ51_TRACE_DATA_BYTES); j++) { if(j) { out.print(" "); } out.print((unsigned long)entry.data[j]); }
+        }
+        out.println();
+      }
+    }
+
+    /**
+     * write the trace in the compact binary format (oldest first, see above)
+     * @param out anything with write(const uint8_t*, size_t) (like Serial)
+     */
+    template<class STREAM>
+    void dumpBinary(STREAM& out) const {
+      uint16_t entryCount = count();
+      uint8_t header[13] = {'B','Q','5','1','T', 1, BQ51_TRACE_DATA_BYTES, (uint8_t)entryCount, (uint8_t)(entryCount>>8),
+                            (uint8_t)total, (uint8_t)(total>>8), (uint8_t)(total>>16), (uint8_t)(total>>24)};
+      out.write(header, sizeof(header));
+      for(uint16_t i=0; i<entryCount; i++) {
+        const BQ51_traceEntry& entry = (*this)[i];
+        uint8_t packed[11 + BQ51_TRACE_DATA_BYTES] = {(uint8_t)entry.timestamp, (uint8_t)(entry.timestamp>>8), (uint8_t)(entry.timestamp>>16), (uint8_t)(entry.timestamp>>24),
+                                                      (uint8_t)entry.duration, (uint8_t)(entry.duration>>8), entry.flags, entry.reg, entry.length,
+                                                      (uint8_t)entry.result, (uint8_t)(((uint16_t)entry.result)>>8)};
+        memcpy(&packed[11], entry.data, BQ51_TRACE_DATA_BYTES);
+        out.write(packed, sizeof(packed));
+      }
+    }
+  };
+#endif
+
 
 //// some I2C constants
 #define TW_WRITE 0 //https://en.wikipedia.org/wiki/I%C2%B2C  under "Addressing structure"
@@ -75,6 +339,12 @@ class _BQ51_thijs_base
   static const uint8_t slaveAddress = 0x6C; //7-bit address
   const bool isBQ51021; // (BQ5122x or BQ51021) the BQ51021 only lacks 2 functions, but still
   _BQ51_thijs_base(bool isBQ51021=false) : isBQ51021(isBQ51021) {}
+  #ifdef BQ51_useInstrumentation
+    BQ51_instrumentation instrumentation; // statistics of all transactions done through BQ51_thijs (see BQ51_useInstrumentation)
+  #endif
+  #ifdef BQ51_useTrace
+    BQ51_trace trace; // the most recent transactions done through BQ51_thijs (see BQ51_useTrace)
+  #endif
   
   #ifdef BQ51_useWireLib // higher level generalized (arduino wire library):
 
@@ -101,7 +371,8 @@ class _BQ51_thijs_base
       // HOWEVER, this function is not implemented on all platforms (looking at you, MSP430!), and it's not that hard to do manually anyway, so:
       Wire.beginTransmission(slaveAddress);
       Wire.write(registerToRead);
-      Wire.endTransmission(); // the generalized Wire library is not always capable of repeated starts (on all platforms)
+      lastWireError = Wire.endTransmission(!BQ51_WIRE_REPEATED_START); // no STOP (so the read starts with a repeated start), if the core supports it
+      if(!_wireGood(lastWireError)) { BQ51debugPrint("requestReadBytes() endTransmission error!"); return(false); }
       return(onlyReadBytes(readBuff, bytesToRead));
     }
     
@@ -112,11 +383,11 @@ class _BQ51_thijs_base
      * @return whether it read successfully
      */
     bool onlyReadBytes(uint8_t readBuff[], uint8_t bytesToRead) {
-      Wire.requestFrom(slaveAddress, bytesToRead);
-      if(Wire.available() != bytesToRead) { BQ51debugPrint("onlyReadBytes() received insufficient data"); return(false); }
-      for(uint8_t i=0; i<bytesToRead; i++) { readBuff[i] = Wire.read(); } // dumb byte-by-byte copy
-      // unfortunately, TwoWire.rxBuffer is a private member, so we cant just memcpy. Then again, this implementation is not meant to be efficient
-      return(true);
+      uint8_t received = Wire.requestFrom(slaveAddress, bytesToRead);
+      if(received != bytesToRead) { BQ51debugPrint("onlyReadBytes() received insufficient data"); while(Wire.available()) { Wire.read(); } return(false); } // (empty the rx buffer, so the next read doesn't get leftovers)
+      // TwoWire.rxBuffer is a private member, so we can't just memcpy, but readBytes() is a single call (and some cores do memcpy internally)
+      // the bytes are already in the rx buffer, so the Stream timeout never comes into play
+      return(Wire.readBytes(readBuff, bytesToRead) == bytesToRead);
     }
     
     
@@ -131,10 +402,197 @@ class _BQ51_thijs_base
       Wire.beginTransmission(slaveAddress);
       Wire.write(registerToWrite);
       Wire.write(writeBuff, bytesToWrite); // (usually) just calls a forloop that calls .write(byte) for every byte.
-      Wire.endTransmission(); // this implementation does not really handle repeated starts (on all platforms)
+      lastWireError = Wire.endTransmission(); // (with STOP)
+      if(lastWireError != 0) { BQ51debugPrint("writeBytes() endTransmission error!"); return(false); }
+      return(true);
+    }
+
+    uint8_t lastWireError = 0; // the last Wire.endTransmission() result (0=success, 1=data too long, 2=NACK on address, 3=NACK on data, 4=other, 5=timeout (on some cores))
+
+    private:
+    /**
+     * (private) check an endTransmission() result
+     * @param wireErr Wire.endTransmission() result
+     * @return whether it's a success
+     */
+    static inline bool _wireGood(uint8_t wireErr) {
+      #if defined(ARDUINO_ARCH_ESP32) && BQ51_WIRE_REPEATED_START
+        return((wireErr == 0) || (wireErr == 7)); // ESP32 core 1.x returns 7 (I2C_ERROR_CONTINUE) for endTransmission(false), meaning "waiting for the read"
+      #else
+        return(wireErr == 0);
+      #endif
+    }
+    public:
+
+  #elif defined(BQ51_useHostSim) // simulated device (for running on a host)
+
+    public:
+    BQ51_simDevice* simDevice = &BQ51_simDevice::shared(); // the simulated device this object talks to
+
+    /**
+     * 'initialize' the simulated bus
+     * @param frequency SCL clock freq in Hz (only used for the bus timing model)
+     * @param device (optional) the simulated device to talk to (by default, all objects share BQ51_simDevice::shared())
+     */
+    void init(uint32_t frequency, BQ51_simDevice* device=NULL) {
+      if(device != NULL) { simDevice = device; }
+      simDevice->SCLfrequency = frequency;
+    }
+
+    /**
+     * request a specific register and read bytes into a buffer
+     * @param registerToRead register byte (see list of defines at top)
+     * @param readBuff a buffer to store the read values in
+     * @param bytesToRead how many bytes to read
+     * @return whether it wrote/read successfully
+     */
+    bool requestReadBytes(uint8_t registerToRead, uint8_t readBuff[], uint8_t bytesToRead) {
+      if(!simDevice->requestRead(registerToRead, readBuff, bytesToRead)) { BQ51debugPrint("requestReadBytes() NACK"); return(false); }
+      return(true);
+    }
+
+    /**
+     * read bytes into a buffer (without first writing a register value!)
+     * @param readBuff a buffer to store the read values in
+     * @param bytesToRead how many bytes to read
+     * @return whether it read successfully
+     */
+    bool onlyReadBytes(uint8_t readBuff[], uint8_t bytesToRead) {
+      if(!simDevice->onlyRead(readBuff, bytesToRead)) { BQ51debugPrint("onlyReadBytes() NACK"); return(false); }
       return(true);
     }
 
+    /**
+     * request a specific register and write bytes from a buffer
+     * @param registerToWrite register byte (see list of defines at top)
+     * @param writeBuff a buffer of bytes to write to the device
+     * @param bytesToWrite how many bytes to write
+     * @return whether it wrote successfully
+     */
+    bool writeBytes(uint8_t registerToWrite, uint8_t writeBuff[], uint8_t bytesToWrite) {
+      if(!simDevice->write(registerToWrite, writeBuff, bytesToWrite)) { BQ51debugPrint("writeBytes() NACK"); return(false); }
+      return(true);
+    }
+
+  #elif defined(BQ51_useLinuxI2C) // Linux i2c-dev
+
+    /* Notes on the Linux i2c-dev interface:
+    The usual way to read a register is write() followed by read(), which is 2 syscalls AND 2 seperate transactions (with a STOP in between).
+    The I2C_RDWR ioctl takes a list of messages, which the adapter driver executes as one combined transaction (with repeated STARTs),
+     so a register read is a single syscall. Writes also go through I2C_RDWR, with the register byte and data as 2 messages,
+     where the second one has I2C_M_NOSTART (so they end up as one message on the wire, without copying the data into a new buffer).
+    Not all adapters support I2C_M_NOSTART (see I2C_FUNC_NOSTART), in which case the data is copied after all (it's only a few bytes).
+    All ioctl calls go through ioctlFunc, which can be replaced by a stand-in (for testing without hardware).
+    */
+
+    public:
+    /**
+     * function with the same signature (and errno behaviour) as ioctl(), see ioctlFunc
+     */
+    typedef int (*BQ51_ioctlFunc)(int fd, unsigned long request, void* arg);
+    static int _defaultIoctl(int fd, unsigned long request, void* arg) { return(ioctl(fd, request, arg)); }
+
+    BQ51_ioctlFunc ioctlFunc = _defaultIoctl; // replace this to test without hardware (before calling init())
+    int fd = -1;        // file descriptor of the /dev/i2c-N device
+    bool ownsFd = false; // whether end() should close fd
+    bool canNoStart = false; // whether the adapter supports I2C_M_NOSTART (determined in init())
+
+    /**
+     * open and check the I2C bus
+     * @param devicePath path to the i2c-dev device, like "/dev/i2c-1"
+     * @return (errno) 0 if successful
+     */
+    int init(const char* devicePath="/dev/i2c-1") {
+      int newFd = open(devicePath, O_RDWR);
+      if(newFd < 0) { BQ51debugPrint("init() failed to open i2c-dev device!"); return(errno); }
+      int err = init(newFd);
+      if(err != 0) { close(newFd); fd = -1; return(err); }
+      ownsFd = true;
+      return(0);
+    }
+
+    /**
+     * use an already opened I2C bus (to share it between several objects, or with other code)
+     * @param existingFd file descriptor of an opened i2c-dev device
+     * @return (errno) 0 if successful
+     */
+    int init(int existingFd) {
+      fd = existingFd;  ownsFd = false;
+      unsigned long funcs = 0;
+      if(ioctlFunc(fd, I2C_FUNCS, &funcs) < 0) { BQ51debugPrint("init() I2C_FUNCS failed!"); return(errno); }
+      if(!(funcs & I2C_FUNC_I2C)) { BQ51debugPrint("init() adapter doesn't support I2C_RDWR!"); return(EOPNOTSUPP); }
+      canNoStart = (funcs & I2C_FUNC_NOSTART);
+      return(0);
+    }
+
+    /**
+     * close the I2C bus (only if init() opened it)
+     */
+    void end() { if(ownsFd && (fd >= 0)) { close(fd); } fd = -1;  ownsFd = false; }
+
+    private:
+    /**
+     * (private) execute messages as one combined transaction
+     * @return (errno) 0 if successful
+     */
+    int _transfer(struct i2c_msg msgs[], uint8_t count) {
+      struct i2c_rdwr_ioctl_data data = {msgs, count};
+      int ret = ioctlFunc(fd, I2C_RDWR, &data);
+      if(ret < 0) { return((errno != 0) ? errno : EIO); } // (ENXIO/EREMOTEIO means NACK, ETIMEDOUT a stuck bus, EAGAIN lost arbitration)
+      if(ret != count) { return(EIO); } // not all messages were transferred
+      return(0);
+    }
+    public:
+
+    /**
+     * request a specific register and read bytes into a buffer (in one transaction, with a repeated start)
+     * @param registerToRead register byte (see list of defines at top)
+     * @param readBuff a buffer to store the read values in
+     * @param bytesToRead how many bytes to read
+     * @return (errno) 0 if it wrote/read successfully
+     */
+    int requestReadBytes(uint8_t registerToRead, uint8_t readBuff[], uint8_t bytesToRead) {
+      struct i2c_msg msgs[2] = {{slaveAddress, 0, 1, &registerToRead}, {slaveAddress, I2C_M_RD, bytesToRead, readBuff}};
+      int err = _transfer(msgs, 2);
+      if(err != 0) { BQ51debugPrint("requestReadBytes() I2C_RDWR error!"); }
+      return(err);
+    }
+
+    /**
+     * read bytes into a buffer (without first writing a register value!)
+     * @param readBuff a buffer to store the read values in
+     * @param bytesToRead how many bytes to read
+     * @return (errno) 0 if it read successfully
+     */
+    int onlyReadBytes(uint8_t readBuff[], uint8_t bytesToRead) {
+      struct i2c_msg msg = {slaveAddress, I2C_M_RD, bytesToRead, readBuff};
+      int err = _transfer(&msg, 1);
+      if(err != 0) { BQ51debugPrint("onlyReadBytes() I2C_RDWR error!"); }
+      return(err);
+    }
+
+    /**
+     * request a specific register and write bytes from a buffer
+     * @param registerToWrite register byte (see list of defines at top)
+     * @param writeBuff a buffer of bytes to write to the device
+     * @param bytesToWrite how many bytes to write
+     * @return (errno) 0 if it wrote successfully
+     */
+    int writeBytes(uint8_t registerToWrite, uint8_t writeBuff[], uint8_t bytesToWrite) {
+      int err;
+      if(canNoStart) { // register byte and data as one message on the wire, without copying
+        struct i2c_msg msgs[2] = {{slaveAddress, 0, 1, &registerToWrite}, {slaveAddress, I2C_M_NOSTART, bytesToWrite, writeBuff}};
+        err = _transfer(msgs, 2);
+      } else { // the adapter can't glue messages together, so copy (the BQ51 only ever gets a few bytes at a time anyway)
+        uint8_t bufferCopyWithReg[bytesToWrite+1];   bufferCopyWithReg[0] = registerToWrite;
+        memcpy(&bufferCopyWithReg[1], writeBuff, bytesToWrite);
+        struct i2c_msg msg = {slaveAddress, 0, (uint16_t)(bytesToWrite+1), bufferCopyWithReg};
+        err = _transfer(&msg, 1);
+      }
+      if(err != 0) { BQ51debugPrint("writeBytes() I2C_RDWR error!"); }
+      return(err);
+    }
+
   #elif defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) // TODO: test 328p processor defines! (also, this code may be functional on other AVR hw as well?)
     private:
     //// I2C constants:
@@ -191,31 +649,194 @@ class _BQ51_thijs_base
     in both slave modes, if TWEA==0, the slave expects for there to be a STOP/RESTART next 'tick', if not, the status register will read 0 (twi_SR_bus_err)
     */
     
-    inline void twoWireTransferWait() { while(!(TWCR & (1<<TWINT))); }
+    #ifndef BQ51_TWI_TIMEOUT_LOOPS
+      #define BQ51_TWI_TIMEOUT_LOOPS  0x7FFF // max number of loops to wait for TWINT (~10ms at 16MHz, a byte at 100kHz takes ~300 loops)
+    #endif
+
+    static inline void twoWireReset() { TWCR = 0; TWCR = (1<<TWEN); } // disabling the peripheral releases the bus lines (and clears a stuck state)
+
+    static inline bool twoWireTransferWait() {
+      uint16_t loopsLeft = BQ51_TWI_TIMEOUT_LOOPS;
+      while(!(TWCR & (1<<TWINT))) { if(--loopsLeft == 0) { BQ51debugPrint("TWI timeout"); twoWireReset(); return(false); } } // the bus may be locked up, don't wait forever
+      return(true);
+    }
     #define twoWireStatusReg      (TWSR & twi_SR_noPres)
 
-    inline void twiWrite(uint8_t byteToWrite) {
+    inline bool twiWrite(uint8_t byteToWrite) {
       TWDR = byteToWrite;
       TWCR = twi_basic; //initiate transfer
-      twoWireTransferWait();
+      return(twoWireTransferWait());
     }
     
     inline bool startWrite() {
+      #ifdef BQ51_useAsync
+        if(_twiDesc().state == _twiBusy) { BQ51debugPrint("TWI busy with async transaction"); return(false); }
+      #endif
       TWCR = twi_START; //send start
-      twoWireTransferWait();
-      twiWrite((slaveAddress << 1) | TW_WRITE);
+      if(!twoWireTransferWait()) { return(false); }
+      if(!twiWrite((slaveAddress << 1) | TW_WRITE)) { return(false); }
       if(twoWireStatusReg != twi_SR_M_SLA_W_ACK) { BQ51debugPrint("SLA_W ack error"); TWCR = twi_STOP; return(false); }
       return(true);
     }
 
     inline bool startRead() {
       TWCR = twi_START; //repeated start
-      twoWireTransferWait();
-      twiWrite((slaveAddress << 1) | TW_READ);
+      if(!twoWireTransferWait()) { return(false); }
+      if(!twiWrite((slaveAddress << 1) | TW_READ)) { return(false); }
       if(twoWireStatusReg != twi_SR_M_SLA_R_ACK) { BQ51debugPrint("SLA_R ack error"); TWCR = twi_STOP; return(false); }
       return(true);
     }
 
+    inline bool readRemaining(uint8_t readBuff[], uint8_t bytesToRead) { // (after startRead())
+      for(uint8_t i=0; i<(bytesToRead-1); i++) {
+        TWCR = twi_basic_ACK; //request several bytes
+        if(!twoWireTransferWait()) { return(false); }
+        //if(twoWireStatusReg != twi_SR_M_DAT_R_ACK) { BQ51debugPrint("DAT_R Ack error"); return(false); }
+        readBuff[i] = TWDR;
+      }
+      TWCR = twi_basic; //request 1 more byte
+      if(!twoWireTransferWait()) { return(false); }
+      //if(twoWireStatusReg != twi_SR_M_DAT_R_NACK) { BQ51debugPrint("DAT_R Nack error"); return(false); }
+      readBuff[bytesToRead-1] = TWDR;
+      TWCR = twi_STOP;
+      return(true);
+    }
+
+    #ifdef BQ51_useAsync
+      /* Notes on the asynchronous functions:
+      The TWI interrupt (TWI_vect) runs the transaction in the background, using a single static descriptor (no heap, no queue).
+      Only one transaction can be in progress at a time (for all BQ51 objects, as there is only one TWI peripheral).
+      The ISR is defined 'weak' (so this header can be included in multiple files), which also means that if the Wire library
+       is linked in, its (strong) TWI ISR wins, and async transactions will just time out. Don't use both at the same time.
+      */
+      #define BQ51_ASYNC_MAX_WRITE  4 // write data is copied into the descriptor, so the caller can reuse its buffer right away (the BQ51 only needs 4 bytes max)
+      static const uint8_t twi_basic_IE = twi_basic | (1<<TWIE);
+      enum _twiState : uint8_t { _twiIdle = 0, _twiBusy, _twiDone, _twiError };
+
+      struct _twiDescriptor {
+        volatile uint8_t state;     // _twiState
+        uint8_t reg;                // register to read/write
+        uint8_t* readBuff;          // where to put read data (NULL for writes)
+        uint8_t writeData[BQ51_ASYNC_MAX_WRITE]; // copy of the data to write
+        uint8_t length;             // bytes to read/write
+        volatile uint8_t index;     // bytes read/written so far
+        BQ51_asyncCallback callback; // called (from the ISR!) when done (may be NULL)
+        void* callbackArg;          // passed to the callback
+        unsigned long startMillis;  // for the timeout (see asyncPoll())
+      };
+      static _twiDescriptor& _twiDesc() { static _twiDescriptor desc; return(desc); } // (function-local static, so it's shared between all objects without needing a .cpp file)
+
+      static inline void _twiFinish(uint8_t newState) {
+        _twiDescriptor& desc = _twiDesc();
+        desc.state = newState;
+        if(desc.callback != NULL) { desc.callback(desc.callbackArg, newState == _twiDone); }
+      }
+
+      public:
+      /**
+       * (private) the TWI interrupt handler, called from TWI_vect
+       */
+      static void _twiISR() {
+        _twiDescriptor& desc = _twiDesc();
+        switch(twoWireStatusReg) {
+          case twi_SR_M_START: // the transaction always starts by writing the register
+            TWDR = (slaveAddress << 1) | TW_WRITE;  TWCR = twi_basic_IE;  break;
+          case twi_SR_M_RESTART:
+            TWDR = (slaveAddress << 1) | TW_READ;  TWCR = twi_basic_IE;  break;
+          case twi_SR_M_SLA_W_ACK:
+            TWDR = desc.reg;  TWCR = twi_basic_IE;  break;
+          case twi_SR_M_DAT_T_ACK:
+          case twi_SR_M_DAT_T_NACK: // (the blocking functions don't check data ACKs either)
+            if(desc.readBuff != NULL) { TWCR = twi_START | (1<<TWIE); } // repeated start, then read
+            else if(desc.index < desc.length) { TWDR = desc.writeData[desc.index++];  TWCR = twi_basic_IE; }
+            else { TWCR = twi_STOP;  _twiFinish(_twiDone); }
+            break;
+          case twi_SR_M_SLA_R_ACK:
+            TWCR = (desc.length > 1) ? (twi_basic_ACK | (1<<TWIE)) : twi_basic_IE;  break; // NACK the last byte
+          case twi_SR_M_DAT_R_ACK:
+            desc.readBuff[desc.index++] = TWDR;
+            TWCR = (desc.index < (desc.length-1)) ? (twi_basic_ACK | (1<<TWIE)) : twi_basic_IE;  break;
+          case twi_SR_M_DAT_R_NACK:
+            desc.readBuff[desc.index++] = TWDR;
+            TWCR = twi_STOP;  _twiFinish(_twiDone);  break;
+          default: // address NACK, arbitration lost, bus error
+            TWCR = twi_STOP;  _twiFinish(_twiError);  break;
+        }
+      }
+
+      private:
+      bool _asyncStart(uint8_t reg, uint8_t* readBuff, uint8_t length, BQ51_asyncCallback callback, void* callbackArg) {
+        _twiDescriptor& desc = _twiDesc();
+        if(desc.state == _twiBusy) { _asyncTimeoutCheck(); if(desc.state == _twiBusy) { return(false); } }
+        uint16_t loopsLeft = BQ51_TWI_TIMEOUT_LOOPS;
+        while(TWCR & (1<<TWSTO)) { if(--loopsLeft == 0) { twoWireReset(); break; } } // wait for the previous STOP condition to finish
+        desc.reg = reg;  desc.readBuff = readBuff;  desc.length = length;  desc.index = 0;
+        desc.callback = callback;  desc.callbackArg = callbackArg;
+        desc.startMillis = millis();
+        desc.state = _twiBusy;
+        TWCR = twi_START | (1<<TWIE); // the ISR takes it from here
+        return(true);
+      }
+
+      static void _asyncTimeoutCheck() {
+        _twiDescriptor& desc = _twiDesc();
+        bool timedOut = false;
+        uint8_t oldSREG = SREG;  cli(); // (otherwise the ISR could finish the transfer in between the check and the reset, and the callback would fire twice)
+        if((desc.state == _twiBusy) && ((millis() - desc.startMillis) > BQ51_TWI_ASYNC_TIMEOUT_MS)) {
+          TWCR &= ~(1<<TWIE);
+          twoWireReset();
+          desc.state = _twiError;  timedOut = true;
+        }
+        SREG = oldSREG;
+        if(timedOut) { // (the callback runs with interrupts restored, like it would from the ISR)
+          BQ51debugPrint("TWI async timeout");
+          _twiFinish(_twiError);
+        }
+      }
+
+      public:
+      /**
+       * submit a register read, without waiting for it to complete (only 1 transaction at a time)
+       * @param registerToRead register byte (see list of defines at top)
+       * @param readBuff a buffer to store the read values in (must remain valid until the transaction is done!)
+       * @param bytesToRead how many bytes to read (at least 1)
+       * @param callback function to call (from the ISR!) when done (optional)
+       * @param callbackArg argument to pass to the callback
+       * @return whether the transaction was started (false if another one is still in progress)
+       */
+      bool requestReadBytesAsync(uint8_t registerToRead, uint8_t readBuff[], uint8_t bytesToRead, BQ51_asyncCallback callback=NULL, void* callbackArg=NULL) {
+        if(bytesToRead == 0) { return(false); }
+        return(_asyncStart(registerToRead, readBuff, bytesToRead, callback, callbackArg));
+      }
+
+      /**
+       * submit a register write, without waiting for it to complete (the data is copied, so writeBuff may be reused right away)
+       * @param registerToWrite register byte (see list of defines at top)
+       * @param writeBuff a buffer of bytes to write to the device
+       * @param bytesToWrite how many bytes to write (max BQ51_ASYNC_MAX_WRITE)
+       * @param callback function to call (from the ISR!) when done (optional)
+       * @param callbackArg argument to pass to the callback
+       * @return whether the transaction was started (false if another one is still in progress, or bytesToWrite is too large)
+       */
+      bool writeBytesAsync(uint8_t registerToWrite, uint8_t writeBuff[], uint8_t bytesToWrite, BQ51_asyncCallback callback=NULL, void* callbackArg=NULL) {
+        if(bytesToWrite > BQ51_ASYNC_MAX_WRITE) { BQ51debugPrint("writeBytesAsync() too many bytes!"); return(false); }
+        if(_twiDesc().state == _twiBusy) { _asyncTimeoutCheck(); if(_twiDesc().state == _twiBusy) { return(false); } } // (checked before overwriting writeData)
+        for(uint8_t i=0; i<bytesToWrite; i++) { _twiDesc().writeData[i] = writeBuff[i]; }
+        return(_asyncStart(registerToWrite, NULL, bytesToWrite, callback, callbackArg));
+      }
+
+      /**
+       * check whether the asynchronous transaction is done. Also enforces the timeout (BQ51_TWI_ASYNC_TIMEOUT_MS), so call this regularly
+       * @return the number of asynchronous transactions in progress (0 or 1)
+       */
+      static uint8_t asyncPending() { _asyncTimeoutCheck(); return(_twiDesc().state == _twiBusy); }
+
+      /**
+       * @return whether the last (finished) asynchronous transaction was successful
+       */
+      static bool asyncResult() { return(_twiDesc().state == _twiDone); }
+    #endif // BQ51_useAsync
+
     public:
 
     /**
@@ -245,21 +866,10 @@ class _BQ51_thijs_base
      */
     bool requestReadBytes(uint8_t registerToRead, uint8_t readBuff[], uint8_t bytesToRead) {
       if(!startWrite()) { return(false); }
-      twiWrite(registerToRead);  //if(twoWireStatusReg != twi_SR_M_DAT_T_ACK) { return(false); } //should be ACK(?)
+      if(!twiWrite(registerToRead)) { return(false); }  //if(twoWireStatusReg != twi_SR_M_DAT_T_ACK) { return(false); } //should be ACK(?)
       //TWCR = twi_STOP; // TODO: determine if required!
       if(!startRead()) { return(false); }
-      for(uint8_t i=0; i<(bytesToRead-1); i++) {
-        TWCR = twi_basic_ACK; //request several bytes
-        twoWireTransferWait();
-        //if(twoWireStatusReg != twi_SR_M_DAT_R_ACK) { BQ51debugPrint("DAT_R Ack error"); return(false); }
-        readBuff[i] = TWDR;
-      }
-      TWCR = twi_basic; //request 1 more byte
-      twoWireTransferWait();
-      //if(twoWireStatusReg != twi_SR_M_DAT_R_NACK) { BQ51debugPrint("DAT_R Nack error"); return(false); }
-      readBuff[bytesToRead-1] = TWDR;
-      TWCR = twi_STOP;
-      return(true);
+      return(readRemaining(readBuff, bytesToRead));
     }
     
     /**
@@ -269,19 +879,11 @@ class _BQ51_thijs_base
      * @return whether it read successfully
      */
     bool onlyReadBytes(uint8_t readBuff[], uint8_t bytesToRead) {
+      #ifdef BQ51_useAsync
+        if(_twiDesc().state == _twiBusy) { BQ51debugPrint("TWI busy with async transaction"); return(false); }
+      #endif
       if(!startRead()) { return(false); }
-      for(uint8_t i=0; i<(bytesToRead-1); i++) {
-        TWCR = twi_basic_ACK; //request several bytes
-        twoWireTransferWait();
-        //if(twoWireStatusReg != twi_SR_M_DAT_R_ACK) { BQ51debugPrint("DAT_R Ack error"); return(false); }
-        readBuff[i] = TWDR;
-      }
-      TWCR = twi_basic; //request 1 more byte
-      twoWireTransferWait();
-      //if(twoWireStatusReg != twi_SR_M_DAT_R_NACK) { BQ51debugPrint("DAT_R Nack error"); return(false); }
-      readBuff[bytesToRead-1] = TWDR;
-      TWCR = twi_STOP;
-      return(true);
+      return(readRemaining(readBuff, bytesToRead));
     }
     
     
@@ -294,9 +896,9 @@ class _BQ51_thijs_base
      */
     bool writeBytes(uint8_t registerToWrite, uint8_t writeBuff[], uint8_t bytesToWrite) {
       if(!startWrite()) { return(false); }
-      twiWrite(registerToWrite);  //if(twoWireStatusReg != twi_SR_M_DAT_T_ACK) { return(false); } //should be ACK(?)
+      if(!twiWrite(registerToWrite)) { return(false); }  //if(twoWireStatusReg != twi_SR_M_DAT_T_ACK) { return(false); } //should be ACK(?)
       for(uint8_t i=0; i<bytesToWrite; i++) {
-        twiWrite(writeBuff[i]);
+        if(!twiWrite(writeBuff[i])) { return(false); }
         //if(twoWireStatusReg != twi_SR_M_DAT_T_ACK) { return(false); } //should be ACK(?)
       }
       TWCR = twi_STOP;
@@ -424,7 +1026,279 @@ class _BQ51_thijs_base
       #endif
     }
 
+    #ifdef BQ51_useAsync
+      /* Notes on the asynchronous functions:
+      The (legacy) ESP-IDF I2C driver only has blocking functions, so the transactions are handed to a worker task through a FreeRTOS queue.
+      The calling task can continue right away, and gets notified through a callback (from the worker task!) and/or a task notification.
+      All BQ51 objects share the same queue and worker task, so transactions are executed in the order they were submitted.
+      */
+      #ifndef BQ51_ASYNC_QUEUE_LENGTH
+        #define BQ51_ASYNC_QUEUE_LENGTH  8 // max number of transactions waiting in the queue
+      #endif
+      #define BQ51_ASYNC_MAX_WRITE  8 // write data is copied into the queue, so the caller can reuse its buffer right away (the BQ51 only needs 4 bytes max)
+
+      struct _BQ51_asyncJob {
+        _BQ51_thijs_base* device;  // the object to execute the transaction with
+        uint8_t reg;               // register to read/write
+        uint8_t* readBuff;         // where to put read data (NULL for writes)
+        uint8_t writeData[BQ51_ASYNC_MAX_WRITE]; // copy of the data to write
+        uint8_t length;            // bytes to read/write
+        BQ51_asyncCallback callback; // called (from the worker task) when done (may be NULL)
+        void* callbackArg;         // passed to the callback
+        TaskHandle_t notifyTask;   // task to notify (xTaskNotifyGive()) when done (may be NULL)
+      };
+
+      private:
+      static QueueHandle_t& _asyncQueue() { static QueueHandle_t queue = NULL; return(queue); } // (function-local static, so it's shared between all objects without needing a .cpp file)
+      static uint8_t& _asyncCount() { static uint8_t count = 0; return(count); } // transactions queued or in progress (only touched with __atomic builtins)
+
+      static void _asyncWorker(void* unused) {
+        _BQ51_asyncJob job;
+        while(1) {
+          if(xQueueReceive(_asyncQueue(), &job, portMAX_DELAY) != pdTRUE) { continue; }
+          BQ51_ERR_RETURN_TYPE err;
+          if(job.readBuff != NULL) { err = job.device->requestReadBytes(job.reg, job.readBuff, job.length); }
+          else                     { err = job.device->writeBytes(job.reg, job.writeData, job.length); }
+          __atomic_sub_fetch(&_asyncCount(), 1, __ATOMIC_RELEASE);
+          if(job.callback != NULL) { job.callback(job.callbackArg, err); }
+          if(job.notifyTask != NULL) { xTaskNotifyGive(job.notifyTask); }
+        }
+      }
+
+      bool _asyncSubmit(_BQ51_asyncJob& job) {
+        if(_asyncQueue() == NULL) { BQ51debugPrint("async transaction submitted before asyncBegin()!"); return(false); }
+        __atomic_add_fetch(&_asyncCount(), 1, __ATOMIC_ACQUIRE); // (incremented before sending, so the worker can never decrement it first)
+        if(xQueueSend(_asyncQueue(), &job, 0) != pdTRUE) { __atomic_sub_fetch(&_asyncCount(), 1, __ATOMIC_RELEASE); BQ51debugPrint("async queue full!"); return(false); }
+        return(true);
+      }
+
+      public:
+
+      /**
+       * start the (shared) worker task that executes asynchronous transactions (only needs to be called once, not for every BQ51 object)
+       * @param priority FreeRTOS priority of the worker task
+       * @param core which core to run the worker task on (tskNO_AFFINITY for either)
+       * @return (esp_err_t) whether the queue and task could be created
+       */
+      static esp_err_t asyncBegin(UBaseType_t priority=5, BaseType_t core=tskNO_AFFINITY) {
+        if(_asyncQueue() != NULL) { return(ESP_OK); } // already started
+        _asyncQueue() = xQueueCreate(BQ51_ASYNC_QUEUE_LENGTH, sizeof(_BQ51_asyncJob));
+        if(_asyncQueue() == NULL) { return(ESP_ERR_NO_MEM); }
+        if(xTaskCreatePinnedToCore(_asyncWorker, "BQ51_async", 2048, NULL, priority, NULL, core) != pdPASS) {
+          vQueueDelete(_asyncQueue());  _asyncQueue() = NULL; // (so a retry starts over, and submits don't queue jobs that nothing will execute)
+          return(ESP_ERR_NO_MEM);
+        }
+        return(ESP_OK);
+      }
+
+      /**
+       * submit a register read, without waiting for it to complete
+       * @param registerToRead register byte (see list of defines at top)
+       * @param readBuff a buffer to store the read values in (must remain valid until the transaction is done!)
+       * @param bytesToRead how many bytes to read
+       * @param callback function to call (from the worker task) when done (optional)
+       * @param callbackArg argument to pass to the callback
+       * @param notifyTask task to notify (xTaskNotifyGive()) when done, use xTaskGetCurrentTaskHandle() for the calling task (optional)
+       * @return whether the transaction was queued (false if the queue is full or asyncBegin() was not called)
+       */
+      bool requestReadBytesAsync(uint8_t registerToRead, uint8_t readBuff[], uint8_t bytesToRead, BQ51_asyncCallback callback=NULL, void* callbackArg=NULL, TaskHandle_t notifyTask=NULL) {
+        _BQ51_asyncJob job = {this, registerToRead, readBuff, {0}, bytesToRead, callback, callbackArg, notifyTask};
+        return(_asyncSubmit(job));
+      }
+
+      /**
+       * submit a register write, without waiting for it to complete (the data is copied, so writeBuff may be reused right away)
+       * @param registerToWrite register byte (see list of defines at top)
+       * @param writeBuff a buffer of bytes to write to the device
+       * @param bytesToWrite how many bytes to write (max BQ51_ASYNC_MAX_WRITE)
+       * @param callback function to call (from the worker task) when done (optional)
+       * @param callbackArg argument to pass to the callback
+       * @param notifyTask task to notify (xTaskNotifyGive()) when done, use xTaskGetCurrentTaskHandle() for the calling task (optional)
+       * @return whether the transaction was queued (false if the queue is full, asyncBegin() was not called, or bytesToWrite is too large)
+       */
+      bool writeBytesAsync(uint8_t registerToWrite, uint8_t writeBuff[], uint8_t bytesToWrite, BQ51_asyncCallback callback=NULL, void* callbackArg=NULL, TaskHandle_t notifyTask=NULL) {
+        if(bytesToWrite > BQ51_ASYNC_MAX_WRITE) { BQ51debugPrint("writeBytesAsync() too many bytes!"); return(false); }
+        _BQ51_asyncJob job = {this, registerToWrite, NULL, {0}, bytesToWrite, callback, callbackArg, notifyTask};
+        memcpy(job.writeData, writeBuff, bytesToWrite);
+        return(_asyncSubmit(job));
+      }
+
+      /**
+       * @return the number of asynchronous transactions that are queued or in progress (for all BQ51 objects)
+       */
+      static uint8_t asyncPending() { return(__atomic_load_n(&_asyncCount(), __ATOMIC_ACQUIRE)); }
+    #endif // BQ51_useAsync
+
   #elif defined(__MSP430FR2355__) //TBD: determine other MSP430 compatibility: || defined(ENERGIA_ARCH_MSP430) || defined(__MSP430__)
+    //#define BQ51_MSP430_direct  // drive the eUSCI_B peripheral registers directly, instead of going through the Energia twi layer
+    #ifdef BQ51_MSP430_direct
+
+    /* Notes on the eUSCI_B peripheral (in I2C master mode), see the MSP430FR4xx/FR2xx family user's guide (SLAU445) chapter 24:
+    The Energia twi layer sends a STOP between the register write and the read, and writeBytes() has to copy the data to prepend the register.
+    Driving the registers directly (much like the AVR code drives TWCR/TWDR) fixes both, and skips the (interrupt driven) twi state machine.
+    - setting UCTXSTT generates a (repeated) START + address. UCTR selects transmitter/receiver.
+    - UCTXIFG0 is set when TXBUF can take the next byte (right after the START, and whenever a byte moves to the shift register)
+    - UCRXIFG0 is set when a byte was received. Reading RXBUF releases SCL for the next byte.
+    - UCTXSTP must be set while the last byte is being received (so the hardware NACKs it), or after the last byte moved to the shift register (when writing)
+    - UCNACKIFG is set when the address or a data byte was NACKed, the transaction must then be ended with UCTXSTP
+    All waits are bounded by BQ51_MSP430_TIMEOUT_LOOPS, after which the peripheral is reset (UCSWRST), like the AVR code does.
+    */
+
+    #ifndef BQ51_MSP430_EUSCI
+      #define BQ51_MSP430_EUSCI  0 // eUSCI_B module to use: 0 (SDA=P1.2, SCL=P1.3) or 1 (SDA=P4.6, SCL=P4.7)
+    #endif
+    #ifndef BQ51_MSP430_TIMEOUT_LOOPS
+      #define BQ51_MSP430_TIMEOUT_LOOPS  0x7FFF // max number of loops to wait for a flag (a byte at 100kHz takes ~100 loops at 16MHz)
+    #endif
+    #define _BQ51_UCB_CAT(num, reg)  UCB##num##reg
+    #define _BQ51_UCB_EXP(num, reg)  _BQ51_UCB_CAT(num, reg)
+    #define BQ51_UCB(reg)  _BQ51_UCB_EXP(BQ51_MSP430_EUSCI, reg) // like: BQ51_UCB(CTLW0) -> UCB0CTLW0
+
+    static inline void _ucbReset() { BQ51_UCB(CTLW0) |= UCSWRST; BQ51_UCB(CTLW0) &= ~UCSWRST; } // releases the bus lines and clears all flags (but keeps the configuration)
+
+    /**
+     * (private) wait for an interrupt flag (or a NACK)
+     * @param flag UCB IFG bit to wait for
+     * @return true if the flag got set, false if there was a NACK or a timeout
+     */
+    static inline bool _ucbWaitFlag(uint16_t flag) {
+      uint16_t loopsLeft = BQ51_MSP430_TIMEOUT_LOOPS;
+      while(!(BQ51_UCB(IFG) & flag)) {
+        if(BQ51_UCB(IFG) & UCNACKIFG) { return(false); }
+        if(--loopsLeft == 0) { BQ51debugPrint("eUSCI timeout"); _ucbReset(); return(false); } // the bus may be locked up, don't wait forever
+      }
+      return(true);
+    }
+
+    /**
+     * (private) wait for a UCBxCTLW0 bit (UCTXSTT or UCTXSTP) to be cleared by the hardware
+     * @return false if it timed out
+     */
+    static inline bool _ucbWaitClear(uint16_t bit) {
+      uint16_t loopsLeft = BQ51_MSP430_TIMEOUT_LOOPS;
+      while(BQ51_UCB(CTLW0) & bit) { if(--loopsLeft == 0) { BQ51debugPrint("eUSCI timeout"); _ucbReset(); return(false); } }
+      return(true);
+    }
+
+    /**
+     * (private) end a failed transaction (send a STOP after a NACK)
+     * @return false (always, for convenience)
+     */
+    static bool _ucbAbort() {
+      if(BQ51_UCB(IFG) & UCNACKIFG) { // (after a timeout, _ucbReset() already cleared everything)
+        BQ51_UCB(CTLW0) |= UCTXSTP;
+        _ucbWaitClear(UCTXSTP);
+        BQ51_UCB(IFG) &= ~UCNACKIFG;
+        BQ51debugPrint("eUSCI NACK");
+      }
+      return(false);
+    }
+
+    /**
+     * (private) START (or repeated START) as transmitter, and send the first byte
+     * @return whether it was ACKed
+     */
+    bool _ucbStartWrite(uint8_t firstByte) {
+      uint16_t loopsLeft = BQ51_MSP430_TIMEOUT_LOOPS;
+      while(BQ51_UCB(STATW) & UCBBUSY) { if(--loopsLeft == 0) { BQ51debugPrint("eUSCI bus busy"); _ucbReset(); return(false); } } // (another master, or a stuck slave)
+      BQ51_UCB(I2CSA) = slaveAddress;
+      BQ51_UCB(IFG) &= ~(UCNACKIFG | UCTXIFG0 | UCRXIFG0);
+      BQ51_UCB(CTLW0) |= UCTR | UCTXSTT;
+      if(!_ucbWaitFlag(UCTXIFG0)) { return(_ucbAbort()); } // (set as soon as the START is generated)
+      BQ51_UCB(TXBUF) = firstByte;
+      return(true);
+    }
+
+    /**
+     * (private) (repeated) START as receiver, read bytes and STOP
+     * @return whether it read successfully
+     */
+    bool _ucbReceive(uint8_t readBuff[], uint8_t bytesToRead) {
+      BQ51_UCB(CTLW0) &= ~UCTR;
+      BQ51_UCB(CTLW0) |= UCTXSTT;
+      if(bytesToRead == 1) { // the STOP must be requested right after the address is ACKed
+        if(!_ucbWaitClear(UCTXSTT)) { return(false); }
+        if(BQ51_UCB(IFG) & UCNACKIFG) { return(_ucbAbort()); }
+        BQ51_UCB(CTLW0) |= UCTXSTP;
+      }
+      for(uint8_t i=0; i<bytesToRead; i++) {
+        if(!_ucbWaitFlag(UCRXIFG0)) { return(_ucbAbort()); }
+        readBuff[i] = BQ51_UCB(RXBUF); // (this releases SCL for the next byte)
+        if((i+2) == bytesToRead) { BQ51_UCB(CTLW0) |= UCTXSTP; } // the last byte is being received now, so NACK+STOP after it
+      }
+      return(_ucbWaitClear(UCTXSTP));
+    }
+
+    public:
+
+    /**
+     * initialize I2C peripheral (the eUSCI_B module selected by BQ51_MSP430_EUSCI, clocked from SMCLK)
+     * @param frequency SCL clock freq in Hz
+     * @return the actual SCL frequency (the divider is an integer)
+     */
+    uint32_t init(uint32_t frequency) {
+      BQ51_UCB(CTLW0) = UCSWRST; // hold the module in reset while configuring
+      BQ51_UCB(CTLW0) |= UCMODE_3 | UCMST | UCSYNC | UCSSEL__SMCLK; // I2C master, SMCLK
+      BQ51_UCB(CTLW1) = 0; // no automatic STOP (this code does that manually)
+      uint16_t divider = (F_CPU + frequency - 1) / frequency; // (round up, so the result is never faster than requested)
+      BQ51_UCB(BRW) = (divider < 4) ? 4 : divider; // (the eUSCI needs a divider of at least 4 in I2C mode, i think)
+      #if BQ51_MSP430_EUSCI == 0
+        P1SEL0 |= BIT2 | BIT3;  P1SEL1 &= ~(BIT2 | BIT3); // P1.2 = UCB0SDA, P1.3 = UCB0SCL
+      #else
+        P4SEL0 |= BIT6 | BIT7;  P4SEL1 &= ~(BIT6 | BIT7); // P4.6 = UCB1SDA, P4.7 = UCB1SCL
+      #endif
+      BQ51_UCB(CTLW0) &= ~UCSWRST;
+      return(F_CPU / BQ51_UCB(BRW));
+    }
+
+    /**
+     * request a specific register and read bytes into a buffer (with a repeated start)
+     * @param registerToRead register byte (see list of defines at top)
+     * @param readBuff a buffer to store the read values in
+     * @param bytesToRead how many bytes to read
+     * @return whether it wrote/read successfully
+     */
+    bool requestReadBytes(uint8_t registerToRead, uint8_t readBuff[], uint8_t bytesToRead) {
+      if(!_ucbStartWrite(registerToRead)) { return(false); }
+      if(!_ucbWaitFlag(UCTXIFG0)) { return(_ucbAbort()); } // the register byte moved to the shift register (so the address was ACKed)
+      return(_ucbReceive(readBuff, bytesToRead)); // the repeated START happens right after the register byte
+    }
+
+    /**
+     * read bytes into a buffer (without first writing a register value!)
+     * @param readBuff a buffer to store the read values in
+     * @param bytesToRead how many bytes to read
+     * @return whether it read successfully
+     */
+    bool onlyReadBytes(uint8_t readBuff[], uint8_t bytesToRead) {
+      uint16_t loopsLeft = BQ51_MSP430_TIMEOUT_LOOPS;
+      while(BQ51_UCB(STATW) & UCBBUSY) { if(--loopsLeft == 0) { BQ51debugPrint("eUSCI bus busy"); _ucbReset(); return(false); } }
+      BQ51_UCB(I2CSA) = slaveAddress;
+      BQ51_UCB(IFG) &= ~(UCNACKIFG | UCTXIFG0 | UCRXIFG0);
+      return(_ucbReceive(readBuff, bytesToRead));
+    }
+
+    /**
+     * request a specific register and write bytes from a buffer (straight from writeBuff, no copy)
+     * @param registerToWrite register byte (see list of defines at top)
+     * @param writeBuff a buffer of bytes to write to the device
+     * @param bytesToWrite how many bytes to write
+     * @return whether it wrote successfully
+     */
+    bool writeBytes(uint8_t registerToWrite, uint8_t writeBuff[], uint8_t bytesToWrite) {
+      if(!_ucbStartWrite(registerToWrite)) { return(false); }
+      for(uint8_t i=0; i<bytesToWrite; i++) {
+        if(!_ucbWaitFlag(UCTXIFG0)) { return(_ucbAbort()); }
+        BQ51_UCB(TXBUF) = writeBuff[i];
+      }
+      if(!_ucbWaitFlag(UCTXIFG0)) { return(_ucbAbort()); } // the last byte moved to the shift register
+      BQ51_UCB(CTLW0) |= UCTXSTP;
+      if(!_ucbWaitClear(UCTXSTP)) { return(false); }
+      if(BQ51_UCB(IFG) & UCNACKIFG) { BQ51_UCB(IFG) &= ~UCNACKIFG; BQ51debugPrint("eUSCI NACK"); return(false); } // the last byte may have been NACKed
+      return(true);
+    }
+
+    #else // through the Energia twi layer
 
     public:
 
@@ -486,6 +1360,8 @@ class _BQ51_thijs_base
       // so, I'm just stuck copying the writeBuff to yet another buffer. Luckily, the BQ51 only accepts 2-byte data anyway, so it's a small buffer...
     }
 
+    #endif // BQ51_MSP430_direct
+
   #elif defined(ARDUINO_ARCH_STM32)
   
     /* Notes on the STM32 I2C perihperal (specifically that of the STM32WB55):
@@ -518,7 +1394,7 @@ class _BQ51_thijs_base
      * @return (pointer to) the i2c_t object that was initialized. (to be passed to subsequent init() functions)
      */
     i2c_t* init(uint32_t frequency, uint32_t SDApin=PIN_WIRE_SDA, uint32_t SCLpin=PIN_WIRE_SCL, bool generalCall = false) {
-      _i2c = new i2c_t;
+      _i2c = new i2c_t(); // (value-initialized, so unused members like handle.hdmarx are NULL)
       _i2c->sda = digitalPinToPinName(SDApin);
       _i2c->scl = digitalPinToPinName(SCLpin);
       _i2c->__this = (void *)this; // i truly do not understand the stucture of the STM32 i2c_t, but whatever, i guess the i2c_t class needs to know where this higher level class is or something
@@ -535,6 +1411,271 @@ class _BQ51_thijs_base
     */
     void init(i2c_t* i2c_t_Ptr) { _i2c = i2c_t_Ptr; } // use the pre-initialized i2c_t object
     
+    //#define BQ51_STM32_direct  // drive the I2C peripheral registers directly for the (blocking) transactions, instead of going through twi.h and the HAL
+    #ifdef BQ51_STM32_direct
+
+    /* Notes on driving the STM32 I2C peripheral directly:
+    i2c_master_write()/i2c_master_read() go through several layers of HAL state machine for every call, which is a large part of the total time
+     for the 1~6 byte transactions the BQ51 needs. Also, the register write and the read are only joined by a repeated start where I2C_OTHER_FRAME exists.
+    init() still goes through i2c_custom_init() (pins, clocks, timing), only the transactions themselves use the registers of _i2c->handle.Instance.
+    There are 2 (very) different I2C peripherals in the STM32 family (see the reference manual of the subfamily):
+    - 'v2' (F0, F3, F7, G0, G4, H7, L0, L4, L5, U5, WB, WL): the transfer length is loaded into CR2.NBYTES along with START,
+       and the hardware does the rest (ACK/NACK of the last byte, and the STOP if AUTOEND is set). Without AUTOEND, TC is set after the last byte,
+       and a new START (with RD_WRN) is a repeated start.
+    - 'v1' (F1, F2, F4, L1): every step is manual (SB -> DR=address -> ADDR -> data), and the ACK/POS/STOP bits have to be set at just the right moment
+       when receiving the last 1~3 bytes (see the 'master receiver' section of the reference manual).
+    All waits are bounded by BQ51_STM32_TIMEOUT_MS, after which the peripheral is reset (its configuration is kept).
+    The HAL never finds out about these transactions, so don't mix them with a HAL transaction in progress (e.g. BQ51_useAsync) on the same bus.
+    */
+
+    #ifndef BQ51_STM32_TIMEOUT_MS
+      #define BQ51_STM32_TIMEOUT_MS  5 // max time to wait for a flag (a whole BQ51 transaction takes <1ms at 100kHz)
+    #endif
+    #if defined(I2C_CR2_NBYTES) // 'v2' peripheral
+      #define _BQ51_STM32_STATUS(i2c)  ((i2c)->ISR)
+      #define _BQ51_STM32_NACK  I2C_ISR_NACKF
+      #define _BQ51_STM32_ERRORS  (I2C_ISR_BERR | I2C_ISR_ARLO)
+    #elif defined(I2C_SR1_SB) // 'v1' peripheral
+      #define _BQ51_STM32_STATUS(i2c)  ((i2c)->SR1)
+      #define _BQ51_STM32_NACK  I2C_SR1_AF
+      #define _BQ51_STM32_ERRORS  (I2C_SR1_BERR | I2C_SR1_ARLO)
+    #else
+      #error("BQ51_STM32_direct: unknown I2C peripheral on this STM32 subfamily")
+    #endif
+
+    /**
+     * (private) wait for a status flag (or a NACK, bus error or timeout)
+     * @param i2c the I2C peripheral
+     * @param flag ISR (v2) or SR1 (v1) bit to wait for
+     * @param nackCode what to return if there was a NACK (I2C_NACK_ADDR or I2C_NACK_DATA)
+     * @return I2C_OK if the flag got set, otherwise the error
+     */
+    static i2c_status_e _stmWaitFlag(I2C_TypeDef* i2c, uint32_t flag, i2c_status_e nackCode) {
+      uint32_t startMillis = millis();
+      while(true) {
+        uint32_t status = _BQ51_STM32_STATUS(i2c);
+        if(status & _BQ51_STM32_NACK) { return(nackCode); } // (checked first, as the v2 STOPF is also set after a NACK)
+        if(status & _BQ51_STM32_ERRORS) { return(I2C_ERROR); }
+        if(status & flag) { return(I2C_OK); }
+        if((millis() - startMillis) > BQ51_STM32_TIMEOUT_MS) { return(I2C_TIMEOUT); }
+      }
+    }
+
+    /**
+     * (private) wait for the bus to be free before a START
+     * @return I2C_OK or I2C_BUSY
+     */
+    static i2c_status_e _stmWaitIdle(I2C_TypeDef* i2c) {
+      uint32_t startMillis = millis();
+      #if defined(I2C_CR2_NBYTES)
+        while(i2c->ISR & I2C_ISR_BUSY) { if((millis() - startMillis) > BQ51_STM32_TIMEOUT_MS) { return(I2C_BUSY); } }
+        i2c->ICR = I2C_ICR_NACKCF | I2C_ICR_STOPCF; // (leftovers from a previous (failed) transaction)
+      #else
+        while(i2c->SR2 & I2C_SR2_BUSY) { if((millis() - startMillis) > BQ51_STM32_TIMEOUT_MS) { return(I2C_BUSY); } }
+        i2c->SR1 &= ~I2C_SR1_AF;
+      #endif
+      return(I2C_OK);
+    }
+
+    /**
+     * (private) wait for the STOP condition to finish (and clear STOPF on v2)
+     * @return I2C_OK, I2C_NACK_DATA or I2C_TIMEOUT
+     */
+    static i2c_status_e _stmWaitStop(I2C_TypeDef* i2c) {
+      #if defined(I2C_CR2_NBYTES)
+        i2c_status_e err = _stmWaitFlag(i2c, I2C_ISR_STOPF, I2C_NACK_DATA);
+        if(err == I2C_OK) { i2c->ICR = I2C_ICR_STOPCF; }
+        return(err);
+      #else
+        uint32_t startMillis = millis();
+        while(i2c->CR1 & I2C_CR1_STOP) { if((millis() - startMillis) > BQ51_STM32_TIMEOUT_MS) { return(I2C_TIMEOUT); } } // (cleared by hardware once the STOP is sent)
+        return(I2C_OK);
+      #endif
+    }
+
+    /**
+     * (private) end a failed transaction: send a STOP after a NACK, or reset the peripheral after a timeout/bus error
+     * @param err the error that occurred
+     */
+    static void _stmAbort(I2C_TypeDef* i2c, i2c_status_e err) {
+      #if defined(I2C_CR2_NBYTES)
+        if((err == I2C_NACK_ADDR) || (err == I2C_NACK_DATA)) {
+          if(!(i2c->CR2 & I2C_CR2_AUTOEND)) { i2c->CR2 |= I2C_CR2_STOP; } // (the register write phase of a read doesn't end by itself)
+          uint32_t startMillis = millis();
+          while(!(i2c->ISR & I2C_ISR_STOPF)) { if((millis() - startMillis) > BQ51_STM32_TIMEOUT_MS) { err = I2C_TIMEOUT; break; } }
+          i2c->ICR = I2C_ICR_NACKCF | I2C_ICR_STOPCF;
+        }
+        if((err != I2C_NACK_ADDR) && (err != I2C_NACK_DATA)) { // software reset: PE must be low for at least 3 APB clock cycles (the configuration registers are not affected)
+          i2c->CR1 &= ~I2C_CR1_PE;
+          (void)i2c->CR1;  (void)i2c->CR1;  (void)i2c->CR1;
+          i2c->CR1 |= I2C_CR1_PE;
+        }
+      #else
+        i2c->CR1 = (i2c->CR1 & ~(I2C_CR1_ACK | I2C_CR1_POS)) | I2C_CR1_STOP;
+        i2c->SR1 &= ~(I2C_SR1_AF | _BQ51_STM32_ERRORS);
+        if((err != I2C_NACK_ADDR) && (err != I2C_NACK_DATA) && ((_stmWaitStop(i2c) != I2C_OK) || (i2c->SR2 & I2C_SR2_BUSY))) {
+          // the v1 software reset (SWRST) clears all registers, so the configuration (from i2c_custom_init()) has to be put back
+          uint32_t CR1 = i2c->CR1 & (I2C_CR1_ENGC | I2C_CR1_NOSTRETCH), CR2 = i2c->CR2, OAR1 = i2c->OAR1, CCR = i2c->CCR, TRISE = i2c->TRISE;
+          i2c->CR1 |= I2C_CR1_SWRST;
+          i2c->CR1 &= ~I2C_CR1_SWRST;
+          i2c->CR2 = CR2;  i2c->OAR1 = OAR1;  i2c->CCR = CCR;  i2c->TRISE = TRISE;
+          i2c->CR1 = CR1 | I2C_CR1_PE;
+        }
+      #endif
+      BQ51debugPrint("STM32 I2C transaction failed");
+    }
+
+    /**
+     * (private) START (or repeated START) as receiver, read bytes and STOP
+     * @return I2C_OK or the error (the transaction is NOT aborted yet)
+     */
+    i2c_status_e _stmReceive(I2C_TypeDef* i2c, uint8_t readBuff[], uint8_t bytesToRead) {
+      i2c_status_e err;
+      #if defined(I2C_CR2_NBYTES)
+        i2c->CR2 = (slaveAddress << 1) | ((uint32_t)bytesToRead << I2C_CR2_NBYTES_Pos) | I2C_CR2_RD_WRN | I2C_CR2_AUTOEND | I2C_CR2_START; // (the hardware NACKs the last byte and sends the STOP)
+        for(uint8_t i=0; i<bytesToRead; i++) {
+          err = _stmWaitFlag(i2c, I2C_ISR_RXNE, (i == 0) ? I2C_NACK_ADDR : I2C_NACK_DATA);
+          if(err != I2C_OK) { return(err); }
+          readBuff[i] = i2c->RXDR;
+        }
+      #else
+        i2c->CR1 |= I2C_CR1_START;
+        err = _stmWaitFlag(i2c, I2C_SR1_SB, I2C_NACK_ADDR);  if(err != I2C_OK) { return(err); }
+        if(bytesToRead == 2) { i2c->CR1 |= I2C_CR1_ACK | I2C_CR1_POS; } // (POS: the NACK applies to the byte after the current one)
+        else if(bytesToRead > 2) { i2c->CR1 |= I2C_CR1_ACK; }
+        else { i2c->CR1 &= ~I2C_CR1_ACK; }
+        i2c->DR = (slaveAddress << 1) | 1;
+        err = _stmWaitFlag(i2c, I2C_SR1_ADDR, I2C_NACK_ADDR);  if(err != I2C_OK) { return(err); }
+        if(bytesToRead == 1) {
+          (void)i2c->SR2; // (reading SR1 then SR2 clears ADDR)
+          i2c->CR1 |= I2C_CR1_STOP;
+          err = _stmWaitFlag(i2c, I2C_SR1_RXNE, I2C_NACK_DATA);  if(err != I2C_OK) { return(err); }
+          readBuff[0] = i2c->DR;
+        } else if(bytesToRead == 2) {
+          (void)i2c->SR2;
+          i2c->CR1 &= ~I2C_CR1_ACK;
+          err = _stmWaitFlag(i2c, I2C_SR1_BTF, I2C_NACK_DATA);  if(err != I2C_OK) { return(err); } // (both bytes received, SCL is stretched)
+          i2c->CR1 |= I2C_CR1_STOP;
+          readBuff[0] = i2c->DR;  readBuff[1] = i2c->DR;
+          i2c->CR1 &= ~I2C_CR1_POS;
+        } else {
+          (void)i2c->SR2;
+          for(uint8_t i=0; i<(bytesToRead-3); i++) {
+            err = _stmWaitFlag(i2c, I2C_SR1_RXNE, I2C_NACK_DATA);  if(err != I2C_OK) { return(err); }
+            readBuff[i] = i2c->DR;
+          }
+          err = _stmWaitFlag(i2c, I2C_SR1_BTF, I2C_NACK_DATA);  if(err != I2C_OK) { return(err); } // (N-2 in DR, N-1 in the shift register)
+          i2c->CR1 &= ~I2C_CR1_ACK; // NACK the last byte
+          readBuff[bytesToRead-3] = i2c->DR;
+          err = _stmWaitFlag(i2c, I2C_SR1_BTF, I2C_NACK_DATA);  if(err != I2C_OK) { return(err); }
+          i2c->CR1 |= I2C_CR1_STOP;
+          readBuff[bytesToRead-2] = i2c->DR;  readBuff[bytesToRead-1] = i2c->DR;
+        }
+      #endif
+      return(_stmWaitStop(i2c));
+    }
+
+    /**
+     * (private) START as transmitter and send the register byte (the transaction is left open)
+     * @param totalBytes (v2 only) how many bytes will be sent in total (including the register byte), 0 to end with TC (for a repeated start) instead of a STOP
+     * @return I2C_OK or the error (the transaction is NOT aborted yet)
+     */
+    i2c_status_e _stmStartWrite(I2C_TypeDef* i2c, uint8_t registerByte, uint16_t totalBytes) {
+      i2c_status_e err = _stmWaitIdle(i2c);  if(err != I2C_OK) { return(err); }
+      #if defined(I2C_CR2_NBYTES)
+        if(totalBytes == 0) { i2c->CR2 = (slaveAddress << 1) | (1UL << I2C_CR2_NBYTES_Pos) | I2C_CR2_START; } // (no AUTOEND: TC gets set after the byte, so a repeated start can follow)
+        else { i2c->CR2 = (slaveAddress << 1) | ((uint32_t)totalBytes << I2C_CR2_NBYTES_Pos) | I2C_CR2_AUTOEND | I2C_CR2_START; }
+        err = _stmWaitFlag(i2c, I2C_ISR_TXIS, I2C_NACK_ADDR);  if(err != I2C_OK) { return(err); }
+        i2c->TXDR = registerByte;
+      #else
+        (void)totalBytes;
+        i2c->CR1 |= I2C_CR1_START;
+        err = _stmWaitFlag(i2c, I2C_SR1_SB, I2C_NACK_ADDR);  if(err != I2C_OK) { return(err); }
+        i2c->DR = (slaveAddress << 1);
+        err = _stmWaitFlag(i2c, I2C_SR1_ADDR, I2C_NACK_ADDR);  if(err != I2C_OK) { return(err); }
+        (void)i2c->SR2; // (reading SR1 then SR2 clears ADDR)
+        i2c->DR = registerByte; // (TXE is set right after ADDR is cleared)
+      #endif
+      return(I2C_OK);
+    }
+
+    /**
+     * request a specific register and read bytes into a buffer (using a repeated start)
+     * @param registerToRead register byte (see list of defines at top)
+     * @param readBuff a buffer to store the read values in
+     * @param bytesToRead how many bytes to read
+     * @return (i2c_status_e or bool) whether it wrote/read successfully
+     */
+    BQ51_ERR_RETURN_TYPE requestReadBytes(uint8_t registerToRead, uint8_t readBuff[], uint8_t bytesToRead) {
+      I2C_TypeDef* i2c = _i2c->handle.Instance;
+      i2c_status_e err = _stmStartWrite(i2c, registerToRead, 0);
+      #if defined(I2C_CR2_NBYTES)
+        if(err == I2C_OK) { err = _stmWaitFlag(i2c, I2C_ISR_TC, I2C_NACK_DATA); }
+      #else
+        if(err == I2C_OK) { err = _stmWaitFlag(i2c, I2C_SR1_BTF, I2C_NACK_DATA); }
+      #endif
+      if(err == I2C_OK) { err = _stmReceive(i2c, readBuff, bytesToRead); }
+      if(err != I2C_OK) { _stmAbort(i2c, err); }
+      #ifdef BQ51_return_i2c_status_e
+        return(err);
+      #else
+        return(err == I2C_OK);
+      #endif
+    }
+
+    /**
+     * read bytes into a buffer (without first writing a register value!)
+     * @param readBuff a buffer to store the read values in
+     * @param bytesToRead how many bytes to read
+     * @return (i2c_status_e or bool) whether it read successfully
+     */
+    BQ51_ERR_RETURN_TYPE onlyReadBytes(uint8_t readBuff[], uint8_t bytesToRead) {
+      I2C_TypeDef* i2c = _i2c->handle.Instance;
+      i2c_status_e err = _stmWaitIdle(i2c);
+      if(err == I2C_OK) { err = _stmReceive(i2c, readBuff, bytesToRead); }
+      if(err != I2C_OK) { _stmAbort(i2c, err); }
+      #ifdef BQ51_return_i2c_status_e
+        return(err);
+      #else
+        return(err == I2C_OK);
+      #endif
+    }
+
+    /**
+     * request a specific register and write bytes from a buffer (sent straight from writeBuff, no copy)
+     * @param registerToWrite register byte (see list of defines at top)
+     * @param writeBuff a buffer of bytes to write to the device
+     * @param bytesToWrite how many bytes to write
+     * @return (i2c_status_e or bool) whether it wrote successfully
+     */
+    BQ51_ERR_RETURN_TYPE writeBytes(uint8_t registerToWrite, uint8_t writeBuff[], uint8_t bytesToWrite) {
+      I2C_TypeDef* i2c = _i2c->handle.Instance;
+      i2c_status_e err = _stmStartWrite(i2c, registerToWrite, bytesToWrite+1);
+      for(uint8_t i=0; (i<bytesToWrite) && (err == I2C_OK); i++) {
+        #if defined(I2C_CR2_NBYTES)
+          err = _stmWaitFlag(i2c, I2C_ISR_TXIS, I2C_NACK_DATA);
+          if(err == I2C_OK) { i2c->TXDR = writeBuff[i]; }
+        #else
+          err = _stmWaitFlag(i2c, I2C_SR1_TXE, I2C_NACK_DATA);
+          if(err == I2C_OK) { i2c->DR = writeBuff[i]; }
+        #endif
+      }
+      #if defined(I2C_CR2_NBYTES)
+        if(err == I2C_OK) { err = _stmWaitStop(i2c); } // (AUTOEND sends the STOP after the last byte)
+      #else
+        if(err == I2C_OK) { err = _stmWaitFlag(i2c, I2C_SR1_BTF, I2C_NACK_DATA); } // (last byte fully sent)
+        if(err == I2C_OK) { i2c->CR1 |= I2C_CR1_STOP;  err = _stmWaitStop(i2c); }
+      #endif
+      if(err != I2C_OK) { _stmAbort(i2c, err); }
+      #ifdef BQ51_return_i2c_status_e
+        return(err);
+      #else
+        return(err == I2C_OK);
+      #endif
+    }
+
+    #else // (twi.h)
+
     /**
      * request a specific register and read bytes into a buffer
      * @param registerToRead register byte (see list of defines at top)
@@ -599,6 +1740,162 @@ class _BQ51_thijs_base
       #endif
     }
 
+    #endif // BQ51_STM32_direct
+
+    #ifdef BQ51_useAsync
+      /* Notes on the asynchronous functions:
+      These use the HAL_I2C_Mem_Read/Write _IT (or _DMA) functions directly on _i2c->handle, which send the register address as the 'memory address',
+       so there is no need to copy the register and payload into one buffer (the payload buffer must remain valid until the transaction is done though).
+      The interrupt handlers are already set up by i2c_custom_init(), so the core is free while the transaction happens in the background.
+      Completion is detected in asyncPending() (so the callback is called from whichever context calls that), unless BQ51_STM32_ASYNC_CALLBACKS
+       is defined (in exactly one .cpp file!), in which case the HAL_I2C_MemRxCpltCallback()/HAL_I2C_MemTxCpltCallback() are defined by this library
+       and the callback is called from the interrupt. (errors and timeouts are always detected in asyncPending(), as twi.c already defines HAL_I2C_ErrorCallback)
+      Define BQ51_STM32_useDMA to use the DMA variants, but note that the Arduino core does not link DMA channels to the I2C handle,
+       you have to set up _i2c->handle.hdmarx / hdmatx yourself (if they're NULL, the _IT variants are used instead).
+      */
+      private:
+      volatile uint8_t _asyncBusy = 0; // whether this object has a transaction in progress
+      BQ51_asyncCallback _asyncCallback = NULL;
+      void* _asyncCallbackArg = NULL;
+      uint32_t _asyncStartMillis = 0;
+
+      static i2c_status_e _HALtoI2Cstatus(HAL_StatusTypeDef HALstatus) {
+        switch(HALstatus) {
+          case HAL_OK: return(I2C_OK);
+          case HAL_BUSY: return(I2C_BUSY);
+          case HAL_TIMEOUT: return(I2C_TIMEOUT);
+          default: return(I2C_ERROR);
+        }
+      }
+
+      BQ51_ERR_RETURN_TYPE _asyncResult(i2c_status_e err) {
+        #ifdef BQ51_return_i2c_status_e
+          return(err);
+        #else
+          return(err == I2C_OK);
+        #endif
+      }
+
+      struct _asyncOwnerEntry { I2C_HandleTypeDef* handle; _BQ51_thijs_base* owner; };
+      /**
+       * (private) table of which object has a transaction in progress on which handle (i2c_t->__this belongs to TwoWire, so that's not used)
+       */
+      static _asyncOwnerEntry* _asyncOwners() { static _asyncOwnerEntry table[BQ51_STM32_ASYNC_HANDLES] = {}; return(table); }
+
+      /**
+       * (private) claim a handle for a transaction
+       * @return false if another object has a transaction in progress on that handle, or the table is full
+       */
+      bool _asyncClaim(I2C_HandleTypeDef* handle) {
+        _asyncOwnerEntry* table = _asyncOwners();
+        _asyncOwnerEntry* freeEntry = NULL;
+        for(uint8_t i=0; i<BQ51_STM32_ASYNC_HANDLES; i++) {
+          if(table[i].handle == handle) {
+            if((table[i].owner != NULL) && (table[i].owner != this)) { return(false); } // (the HAL would return HAL_BUSY anyway)
+            table[i].owner = this;  return(true);
+          }
+          if((freeEntry == NULL) && ((table[i].handle == NULL) || (table[i].owner == NULL))) { freeEntry = &table[i]; }
+        }
+        if(freeEntry == NULL) { BQ51debugPrint("too many async I2C handles, increase BQ51_STM32_ASYNC_HANDLES"); return(false); }
+        freeEntry->owner = NULL;  freeEntry->handle = handle;  freeEntry->owner = this; // (owner last, so the ISR never sees a half-written entry)
+        return(true);
+      }
+
+      /**
+       * (private) release the handle this object claimed
+       */
+      void _asyncRelease() {
+        _asyncOwnerEntry* table = _asyncOwners();
+        for(uint8_t i=0; i<BQ51_STM32_ASYNC_HANDLES; i++) { if(table[i].owner == this) { table[i].owner = NULL; } }
+      }
+
+      bool _asyncStart(uint8_t reg, uint8_t* buff, uint8_t length, bool isRead, BQ51_asyncCallback callback, void* callbackArg) {
+        if(_asyncBusy) { return(false); }
+        I2C_HandleTypeDef* handle = &_i2c->handle;
+        if(!_asyncClaim(handle)) { return(false); } // (for the completion interrupt, in case multiple objects share the same i2c_t)
+        _asyncCallback = callback;  _asyncCallbackArg = callbackArg;
+        _asyncStartMillis = millis();
+        _asyncBusy = 1;
+        HAL_StatusTypeDef HALstatus;
+        #if defined(BQ51_STM32_useDMA)
+          if(isRead && (handle->hdmarx != NULL)) { HALstatus = HAL_I2C_Mem_Read_DMA(handle, (slaveAddress << 1), reg, I2C_MEMADD_SIZE_8BIT, buff, length); }
+          else if(!isRead && (handle->hdmatx != NULL)) { HALstatus = HAL_I2C_Mem_Write_DMA(handle, (slaveAddress << 1), reg, I2C_MEMADD_SIZE_8BIT, buff, length); }
+          else
+        #endif
+        if(isRead) { HALstatus = HAL_I2C_Mem_Read_IT(handle, (slaveAddress << 1), reg, I2C_MEMADD_SIZE_8BIT, buff, length); }
+        else       { HALstatus = HAL_I2C_Mem_Write_IT(handle, (slaveAddress << 1), reg, I2C_MEMADD_SIZE_8BIT, buff, length); }
+        if(HALstatus != HAL_OK) { BQ51debugPrint("async HAL_I2C_Mem_ error!"); _asyncBusy = 0; _asyncRelease(); return(false); }
+        return(true);
+      }
+
+      public:
+      /**
+       * (private) find the object that has a transaction in progress on a handle (for the HAL completion callbacks)
+       * @param handle the HAL handle
+       * @return the object, or NULL if none of the BQ51 objects started a transaction on that handle
+       */
+      static _BQ51_thijs_base* _asyncOwner(I2C_HandleTypeDef* handle) {
+        _asyncOwnerEntry* table = _asyncOwners();
+        for(uint8_t i=0; i<BQ51_STM32_ASYNC_HANDLES; i++) { if(table[i].handle == handle) { return(table[i].owner); } }
+        return(NULL);
+      }
+
+      /**
+       * (private) finish the transaction in progress (called from asyncPending() or the HAL completion callbacks)
+       * @param err the result of the transaction
+       */
+      void _asyncComplete(i2c_status_e err) {
+        if(!_asyncBusy) { return; } // (already reported)
+        _asyncBusy = 0;
+        _asyncRelease();
+        if(_asyncCallback != NULL) { _asyncCallback(_asyncCallbackArg, _asyncResult(err)); }
+      }
+
+      /**
+       * submit a register read, without waiting for it to complete (1 transaction at a time, per object)
+       * @param registerToRead register byte (see list of defines at top)
+       * @param readBuff a buffer to store the read values in (must remain valid until the transaction is done!)
+       * @param bytesToRead how many bytes to read
+       * @param callback function to call when done (optional, see notes above for the context it's called from)
+       * @param callbackArg argument to pass to the callback
+       * @return whether the transaction was started (false if the peripheral is busy)
+       */
+      bool requestReadBytesAsync(uint8_t registerToRead, uint8_t readBuff[], uint8_t bytesToRead, BQ51_asyncCallback callback=NULL, void* callbackArg=NULL) {
+        return(_asyncStart(registerToRead, readBuff, bytesToRead, true, callback, callbackArg));
+      }
+
+      /**
+       * submit a register write, without waiting for it to complete (no copy is made, so writeBuff must remain valid until the transaction is done!)
+       * @param registerToWrite register byte (see list of defines at top)
+       * @param writeBuff a buffer of bytes to write to the device
+       * @param bytesToWrite how many bytes to write
+       * @param callback function to call when done (optional, see notes above for the context it's called from)
+       * @param callbackArg argument to pass to the callback
+       * @return whether the transaction was started (false if the peripheral is busy)
+       */
+      bool writeBytesAsync(uint8_t registerToWrite, uint8_t writeBuff[], uint8_t bytesToWrite, BQ51_asyncCallback callback=NULL, void* callbackArg=NULL) {
+        return(_asyncStart(registerToWrite, writeBuff, bytesToWrite, false, callback, callbackArg));
+      }
+
+      /**
+       * check whether the asynchronous transaction is done (and call the callback if it just finished). Also enforces the timeout (BQ51_STM32_ASYNC_TIMEOUT_MS)
+       * @return the number of asynchronous transactions in progress for this object (0 or 1)
+       */
+      uint8_t asyncPending() {
+        if(!_asyncBusy) { return(0); }
+        I2C_HandleTypeDef* handle = &_i2c->handle;
+        if(HAL_I2C_GetState(handle) == HAL_I2C_STATE_READY) {
+          uint32_t HALerr = HAL_I2C_GetError(handle);
+          _asyncComplete((HALerr == HAL_I2C_ERROR_NONE) ? I2C_OK : ((HALerr & HAL_I2C_ERROR_AF) ? I2C_NACK_ADDR : I2C_ERROR));
+        } else if((millis() - _asyncStartMillis) > BQ51_STM32_ASYNC_TIMEOUT_MS) {
+          BQ51debugPrint("async timeout");
+          HAL_I2C_DeInit(handle);  HAL_I2C_Init(handle); // get the peripheral out of whatever state it's stuck in
+          _asyncComplete(I2C_TIMEOUT);
+        }
+        return(_asyncBusy);
+      }
+    #endif // BQ51_useAsync
+
   #else
     #error("should never happen, platform optimization code has issue (probably at the top there)")
   #endif // platform-optimized code end
@@ -609,4 +1906,16 @@ class _BQ51_thijs_base
   */
 };
 
+#if !defined(BQ51_useWireLib) && (defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__)) && defined(BQ51_useAsync)
+  ISR(TWI_vect, __attribute__((weak))) { _BQ51_thijs_base::_twiISR(); } // weak, so including this header in multiple files doesn't cause duplicate definitions
+#elif !defined(BQ51_useWireLib) && defined(ARDUINO_ARCH_STM32) && defined(BQ51_useAsync) && defined(BQ51_STM32_ASYNC_CALLBACKS)
+  // NOTE: these override the (weak) HAL functions, so only define BQ51_STM32_ASYNC_CALLBACKS in one .cpp file
+  static inline void _BQ51_STM32_asyncCallback(I2C_HandleTypeDef *hi2c) {
+    _BQ51_thijs_base* owner = _BQ51_thijs_base::_asyncOwner(hi2c); // (only act on transactions a BQ51 object started)
+    if(owner != NULL) { owner->_asyncComplete((HAL_I2C_GetError(hi2c) == HAL_I2C_ERROR_NONE) ? I2C_OK : I2C_ERROR); }
+  }
+  extern "C" void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c) { _BQ51_STM32_asyncCallback(hi2c); }
+  extern "C" void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c) { _BQ51_STM32_asyncCallback(hi2c); }
+#endif
+
 #endif // _BQ51_thijs_base_h
@@ -0,0 +1,47 @@
+#ifndef _BQ51_thijs_host_h
+#define _BQ51_thijs_host_h
+
+/*
+a (tiny) stand-in for Arduino.h, for building the library on a regular host (BQ51_useHostSim) or on Linux (BQ51_useLinuxI2C).
+Only the handful of things the library actually uses are provided.
+With BQ51_useHostSim, the clock is a virtual one (in nanoseconds), which only moves forward when the simulated bus charges time for a transaction,
+ or when delay()/delayMicroseconds()/BQ51_hostAdvance_ns() are called. This keeps benchmarks (and CI runs) perfectly repeatable.
+Otherwise, the clock is the (real) monotonic clock.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef BQ51_useHostSim
+  /**
+   * (internal) the virtual host clock, shared by everything that includes this header
+   * @return reference to the clock value in nanoseconds
+   */
+  inline uint64_t& _BQ51_hostClock_ns() { static uint64_t clock_ns = 0; return(clock_ns); }
+
+  /**
+   * move the virtual clock forward (to simulate time spent doing other things)
+   * @param ns nanoseconds to advance
+   */
+  inline void BQ51_hostAdvance_ns(uint64_t ns) { _BQ51_hostClock_ns() += ns; }
+
+  inline unsigned long micros() { return((unsigned long)(_BQ51_hostClock_ns() / 1000)); }
+  inline unsigned long millis() { return((unsigned long)(_BQ51_hostClock_ns() / 1000000)); }
+  inline void delay(unsigned long ms) { BQ51_hostAdvance_ns((uint64_t)ms * 1000000); }
+  inline void delayMicroseconds(unsigned int us) { BQ51_hostAdvance_ns((uint64_t)us * 1000); }
+#else
+  #include <time.h>
+  /**
+   * (internal) the monotonic clock
+   * @return time in nanoseconds
+   */
+  inline uint64_t _BQ51_hostClock_ns() { struct timespec now; clock_gettime(CLOCK_MONOTONIC, &now); return(((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec); }
+
+  inline unsigned long micros() { return((unsigned long)(_BQ51_hostClock_ns() / 1000)); }
+  inline unsigned long millis() { return((unsigned long)(_BQ51_hostClock_ns() / 1000000)); }
+  inline void delayMicroseconds(unsigned int us) { struct timespec duration = {(time_t)(us / 1000000), (long)((us % 1000000) * 1000)}; nanosleep(&duration, NULL); }
+  inline void delay(unsigned long ms) { struct timespec duration = {(time_t)(ms / 1000), (long)((ms % 1000) * 1000000)}; nanosleep(&duration, NULL); }
+#endif
+
+#endif // _BQ51_thijs_host_h
@@ -0,0 +1,226 @@
+#ifndef _BQ51_thijs_sim_h
+#define _BQ51_thijs_sim_h
+
+/*
+an in-memory model of a BQ51 (register map and I2C bus timing), used by the BQ51_useHostSim backend.
+This lets the whole library (and the add-ons) run on a host, to benchmark bus traffic and latency without a board.
+
+The model includes:
+- the register address pointer, which auto-increments after every byte (so burst reads/writes behave like the real thing)
+- the output registers (0xE0+) being reset whenever V_RECT < V_UVLO (and RXID reading as all 1's)
+- the mailbox: writing USER_PKT_DONE=0 starts a packet, which 'takes' packetDuration_us,
+   after which USER_PKT_DONE reads 1 and USER_PKT_ERR reports no_TX (if !txPresent) or bad_header (if the header is 0)
+- (optionally) V_OUT following VO_REG, through a fixed feedback divider ratio, ramping linearly to a new target over VOUTsettle_us
+- (optionally) the FOD settings adding to the reported received power: REC_PWR + RO_FOD (if OFF_EN) + ESRloss * RS_FOD (if ESR_EN)
+- bus timing: every transaction is charged (START + 9 bits per byte (incl. address) + STOP) at the configured SCL frequency,
+   plus a fixed per-transaction overhead, on the virtual host clock (see _BQ51_thijs_host.h)
+The physical inputs (V_RECT, V_OUT, REC_PWR, etc.) are just public members, for the test/benchmark code to set.
+*/
+
+class BQ51_simDevice
+{
+  public:
+  //// physical inputs:
+  bool present = true;      // whether the device ACKs its address at all
+  bool txPresent = true;    // whether there is a transmitter to send proprietary packets to
+  bool isBQ51021 = false;   // (the BQ51021 has no Mode Indicator register)
+  uint8_t VRECT = 0;        // raw V_RECT, LSB = 46mV. NOTE: use setVRECT() to change it, so the UVLO reset is applied
+  uint8_t VOUT = 0;         // raw V_OUT, LSB = 46mV (ignored if VOUTperVO_REG != 0)
+  uint8_t REC_PWR = 0;      // raw received power, LSB = 39mW
+  uint8_t ESRloss = 0;      // raw power lost in the coil ESR, LSB = 39mW (reported on top of REC_PWR, scaled by RS_FOD, if ESR_EN is set in FOD_RAM)
+  uint8_t MODE_IND = 0;     // raw Mode Indicator register
+  uint8_t RXID[BQ51_RXID_size] = {0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC};
+  uint8_t VOUTperVO_REG = 0;        // if non-zero, V_OUT follows VO_REG: V_OUT = VO_REG * this (clamped to V_RECT), like the feedback divider does
+  uint32_t VOUTsettle_us = 0;       // (if VOUTperVO_REG != 0) how long V_OUT takes to ramp to a new VO_REG target (0 = instantly)
+  uint32_t packetDuration_us = 20000; // how long sending a proprietary packet takes
+  //// timing model:
+  uint32_t SCLfrequency = 100000;      // SCL clock frequency in Hz (set by init())
+  uint32_t transactionOverhead_ns = 0; // fixed (driver/software) time charged per transaction, on top of the bits on the wire
+  //// statistics:
+  uint32_t transactions = 0;    // number of START conditions
+  uint32_t bytesTransferred = 0; // bytes on the wire (including address bytes)
+  uint32_t NACKs = 0;           // transactions that failed because !present
+  uint32_t packetsSent = 0;     // proprietary packets that were 'sent' (successfully or not)
+  uint64_t busTime_ns = 0;      // total time charged for bus transactions
+
+  BQ51_simDevice() { powerOnReset(); }
+
+  /**
+   * a shared default instance (used by any BQ51_thijs that didn't get its own in init())
+   */
+  static BQ51_simDevice& shared() { static BQ51_simDevice sharedDevice; return(sharedDevice); }
+
+  /**
+   * reset all registers to their power-on values
+   */
+  void powerOnReset() {
+    memset(regs, 0, sizeof(regs));
+    regs[BQ51_VO_REG] = BQ51_VO_REG_default;
+    regs[BQ51_IO_REG] = BQ51_IO_REG_default;
+    _resetOutputRegs();
+    _pointer = 0;
+  }
+
+  /**
+   * change V_RECT (applying the UVLO reset of the output registers if it drops below V_UVLO)
+   * @param newVal raw V_RECT, LSB = 46mV
+   */
+  void setVRECT(uint8_t newVal) {
+    VRECT = newVal;
+    if(!powered()) { _resetOutputRegs(); }
+  }
+
+  /**
+   * @return whether V_RECT > V_UVLO (so the output registers work)
+   */
+  bool powered() const { return(VRECT >= BQ51_VRECT_UVLO_raw); }
+
+  /**
+   * forget the statistics (not the register contents)
+   */
+  void resetStats() { transactions = 0;  bytesTransferred = 0;  NACKs = 0;  packetsSent = 0;  busTime_ns = 0; }
+
+  //// bus-level functions (used by the BQ51_useHostSim backend):
+
+  /**
+   * write the register address, then (repeated start) read bytes
+   * @return whether the device ACKed
+   */
+  bool requestRead(uint8_t registerToRead, uint8_t readBuff[], uint8_t bytesToRead) {
+    if(!_chargeTransaction(2, bytesToRead+1, 3)) { return(false); } // S, addr+W, reg, Sr, addr+R, data..., P
+    _pointer = registerToRead;
+    _readBytes(readBuff, bytesToRead);
+    return(true);
+  }
+
+  /**
+   * read bytes from wherever the address pointer currently is
+   * @return whether the device ACKed
+   */
+  bool onlyRead(uint8_t readBuff[], uint8_t bytesToRead) {
+    if(!_chargeTransaction(0, bytesToRead+1, 2)) { return(false); } // S, addr+R, data..., P
+    _readBytes(readBuff, bytesToRead);
+    return(true);
+  }
+
+  /**
+   * write the register address, followed by the data bytes
+   * @return whether the device ACKed
+   */
+  bool write(uint8_t registerToWrite, const uint8_t writeBuff[], uint8_t bytesToWrite) {
+    if(!_chargeTransaction(bytesToWrite+2, 0, 2)) { return(false); } // S, addr+W, reg, data..., P
+    _pointer = registerToWrite;
+    _update();
+    for(uint8_t i=0; i<bytesToWrite; i++) { _writeReg(_pointer++, writeBuff[i]); }
+    return(true);
+  }
+
+  uint8_t regs[256]; // the raw register contents (only the writable ones are used, the status registers come from the inputs above)
+
+  private:
+  uint8_t _pointer = 0;        // register address pointer
+  bool _sending = false;       // whether a proprietary packet is being sent
+  uint8_t _VOUTfrom = 0;       // V_OUT when VO_REG was last changed (start of the ramp)
+  uint64_t _VOUTchange_ns = 0; // when VO_REG was last changed
+  uint64_t _sendStart_ns = 0;
+
+  /**
+   * charge the bus time of a transaction to the virtual clock
+   * @param writeBytes bytes in the write phase (including the address byte)
+   * @param readBytes bytes in the read phase (including the address byte)
+   * @param conditions number of START/repeated-START/STOP conditions
+   * @return whether the device ACKed (if not, only the address byte is charged)
+   */
+  bool _chargeTransaction(uint16_t writeBytes, uint16_t readBytes, uint8_t conditions) {
+    transactions++;
+    if(!present) { NACKs++; writeBytes = 1; readBytes = 0; conditions = 2; } // S, addr (NACK), P
+    uint32_t bits = (writeBytes + readBytes) * 9 + conditions;
+    uint64_t duration_ns = ((uint64_t)bits * 1000000000) / SCLfrequency + transactionOverhead_ns;
+    bytesTransferred += writeBytes + readBytes;
+    busTime_ns += duration_ns;
+    BQ51_hostAdvance_ns(duration_ns);
+    return(present);
+  }
+
+  void _readBytes(uint8_t readBuff[], uint8_t bytesToRead) {
+    _update();
+    for(uint8_t i=0; i<bytesToRead; i++) { readBuff[i] = _readReg(_pointer++); }
+  }
+
+  void _resetOutputRegs() {
+    regs[BQ51_MAILBOX] = BQ51_MAILBOX_default;
+    regs[BQ51_FOD_RAM] = 0;
+    regs[BQ51_USER_HEADER_RAM] = 0;
+    memset(&regs[BQ51_PACKET_PAYLOAD], 0, 4);
+    _sending = false;
+  }
+
+  /**
+   * apply everything that depends on time or on other registers (packet completion, V_OUT following VO_REG)
+   */
+  void _update() {
+    if(_sending && ((_BQ51_hostClock_ns() - _sendStart_ns) >= ((uint64_t)packetDuration_us * 1000))) {
+      uint8_t err = txPresent ? ((regs[BQ51_USER_HEADER_RAM] == 0) ? BQ51_MAILBOX_ERR_bad_header : BQ51_MAILBOX_ERR_good) : BQ51_MAILBOX_ERR_no_TX;
+      regs[BQ51_MAILBOX] = (regs[BQ51_MAILBOX] & ~BQ51_MAILBOX_ERR_bits) | BQ51_MAILBOX_SEND_bits | BQ51_MAILBOX_ERR_field::encode(err);
+      _sending = false;  packetsSent++;
+    }
+    if(VOUTperVO_REG != 0) {
+      uint16_t VOUT_mV = (450 + (BQ51_VO_REG_field::decode(regs[BQ51_VO_REG]) * 50)) * VOUTperVO_REG;
+      uint8_t target = (VOUT_mV / BQ51_VOLT_SCALAR_mV < VRECT) ? (VOUT_mV / BQ51_VOLT_SCALAR_mV) : VRECT;
+      uint64_t elapsed_ns = _BQ51_hostClock_ns() - _VOUTchange_ns;
+      if(elapsed_ns >= ((uint64_t)VOUTsettle_us * 1000)) { VOUT = target; }
+      else { VOUT = _VOUTfrom + (int16_t)(((int32_t)target - _VOUTfrom) * (int64_t)elapsed_ns / ((int64_t)VOUTsettle_us * 1000)); }
+    }
+  }
+
+  /**
+   * the received power as reported in REC_PWR, including the FOD offset and ESR compensation (see FOD_RAM)
+   */
+  uint8_t _reportedPower() const {
+    uint16_t reported = REC_PWR;
+    uint8_t FOD = regs[BQ51_FOD_RAM];
+    if(FOD & BQ51_FOD_RAM_OFF_EN_bits) { reported += BQ51_FOD_RO_field::decode(FOD); }
+    if(FOD & BQ51_FOD_RAM_ESR_EN_bits) {
+      uint8_t RS = BQ51_FOD_RS_field::decode(FOD);
+      reported += ((RS >= 2) && (RS <= 4)) ? (ESRloss * RS) : ((RS == 7) ? (ESRloss / 2) : ESRloss); // (see BQ51_RS_FOD_ENUM)
+    }
+    return((reported > 0xFF) ? 0xFF : reported);
+  }
+
+  uint8_t _readReg(uint8_t reg) const {
+    switch(reg) {
+      case BQ51_VRECT_STATUS_RAM:   return(VRECT);
+      case BQ51_VOUT_STATUS_RAM:    return(powered() ? VOUT : 0);
+      case BQ51_REC_PWR_STATUS_RAM: return(powered() ? _reportedPower() : 0);
+      case BQ51_MODE_IND:           return(isBQ51021 ? 0 : MODE_IND);
+    }
+    if((reg >= BQ51_RXID_READBACK) && (reg < (BQ51_RXID_READBACK + BQ51_RXID_size))) {
+      return(powered() ? RXID[reg - BQ51_RXID_READBACK] : 0xFF);
+    }
+    return(regs[reg]);
+  }
+
+  void _writeReg(uint8_t reg, uint8_t value) {
+    if(reg == BQ51_VO_REG) {
+      if(BQ51_VO_REG_field::decode(value) != BQ51_VO_REG_field::decode(regs[reg])) { _VOUTfrom = VOUT;  _VOUTchange_ns = _BQ51_hostClock_ns(); } // (write() already did _update(), so V_OUT is current)
+      regs[reg] = value & BQ51_VO_REG_bits; return;
+    }
+    if(reg == BQ51_IO_REG) { regs[reg] = value & BQ51_IO_REG_bits; return; }
+    if(!powered()) { return; } // the output registers are held in reset
+    if(reg == BQ51_MAILBOX) {
+      uint8_t keepBits = BQ51_MAILBOX_ERR_bits | BQ51_MAILBOX_SEND_bits; // (read-only bits)
+      regs[reg] = (regs[reg] & keepBits) | (value & ~keepBits);
+      if(!(value & BQ51_MAILBOX_SEND_bits) && !_sending) { // writing USER_PKT_DONE=0 starts a packet
+        regs[reg] &= ~BQ51_MAILBOX_SEND_bits;
+        _sending = true;  _sendStart_ns = _BQ51_hostClock_ns();
+      }
+      return;
+    }
+    if((reg == BQ51_FOD_RAM) || (reg == BQ51_USER_HEADER_RAM) || ((reg >= BQ51_PACKET_PAYLOAD) && (reg < (BQ51_PACKET_PAYLOAD + 4)))) {
+      regs[reg] = value;
+    }
+    // all other registers are read-only (or don't exist)
+  }
+};
+
+#endif // _BQ51_thijs_sim_h
@@ -0,0 +1,408 @@
+/*
+
+this is a benchmark of the BQ51 library, running on the host against a simulated BQ51
+For every high-level function, it prints how many I2C transactions and bytes it took, and how much bus time that costs (at 100kHz and 400kHz).
+It returns a non-zero exit code if the simulated device did not behave as expected, so it can be used in CI as well.
+
+*/
+
+#ifndef BQ51_useHostSim
+  #define BQ51_useHostSim  // (normally done through build_flags in platformio.ini)
+#endif
+
+#include <stdio.h>
+
+#include <BQ51_thijs.h>
+#include <BQ51_thijs_batch.h>
+#include <BQ51_thijs_packet.h>
+#include <BQ51_thijs_startup.h>
+#include <BQ51_thijs_presence.h>
+#include <BQ51_thijs_session.h>
+#include <BQ51_thijs_headroom.h>
+#include <BQ51_thijs_replay.h>
+#include <BQ51_thijs_fodcal.h>
+#include <BQ51_thijs_mux.h>
+
+BQ51_thijs BQ51;
+BQ51_simDevice& sim = BQ51_simDevice::shared();
+
+uint8_t failures = 0;
+#define check(condition)  if(!(condition)) { printf("CHECK FAILED: %s (line %d)\n", #condition, __LINE__); failures++; }
+
+#ifdef BQ51_useTrace
+/**
+ * a stream that just collects what is printed/written, to check BQ51_trace::dumpCSV() and dumpBinary()
+ */
+struct bufferStream {
+  char text[512];  uint16_t textLength = 0;
+  uint8_t bin[256];  uint16_t binLength = 0;
+  void print(const char* str) { textLength += snprintf(&text[textLength], sizeof(text) - textLength, "%s", str); }
+  void print(unsigned long value) { textLength += snprintf(&text[textLength], sizeof(text) - textLength, "%lu", value); }
+  void print(long value) { textLength += snprintf(&text[textLength], sizeof(text) - textLength, "%ld", value); }
+  void println() { print("\n"); }
+  void write(const uint8_t* buff, size_t length) { memcpy(&bin[binLength], buff, length);  binLength += length; }
+};
+#endif
+
+/**
+ * run a function and print what it costs on the (simulated) bus
+ * @param name name to print
+ * @param func function (or lambda) to benchmark
+ */
+template<class FUNC>
+void bench(const char* name, FUNC func) {
+  const uint32_t frequencies[2] = {100000, 400000};
+  uint64_t busTime_ns[2];
+  func(); // warm-up (so the numbers are the steady-state cost, e.g. with a filled BQ51_useShadowCache)
+  for(uint8_t i=0; i<2; i++) {
+    BQ51.init(frequencies[i]);
+    sim.resetStats();
+    func();
+    busTime_ns[i] = sim.busTime_ns;
+  }
+  printf("%-28s %3u transactions %4u bytes %8.1fus @100kHz %8.1fus @400kHz\n", name, (unsigned)sim.transactions, (unsigned)sim.bytesTransferred, busTime_ns[0]/1000.0, busTime_ns[1]/1000.0);
+}
+
+int main() {
+  BQ51.init(100000);
+  sim.setVRECT(7500 / BQ51_VOLT_SCALAR_mV);
+  sim.VOUTperVO_REG = 10; // (5V output at the default VO_REG of 500mV)
+  sim.REC_PWR = 2500 / BQ51_WATT_SCALAR_mW;
+
+  check(BQ51.connectionCheck());
+  check(BQ51.poweredCheck_mV() == (7500 / BQ51_VOLT_SCALAR_mV) * BQ51_VOLT_SCALAR_mV);
+
+  //// functional checks:
+  check(BQ51.getVO_REG() == BQ51_VO_REG_default);
+  BQ51.setVO_REG(5);
+  check(BQ51.getVO_REG_mV() == 700);
+  check(BQ51.getVOUT_mV() == ((7000 / BQ51_VOLT_SCALAR_mV) * BQ51_VOLT_SCALAR_mV));
+  BQ51.setFOD_RO(5);
+  check(BQ51.getFOD_RO() == 5);
+  BQ51.setFields(BQ51_FOD_RO_field::with(3) | BQ51_FOD_RS_field::with(BQ51_RS_FOD_2x)); // (2 fields, 1 read-modify-write)
+  check((BQ51.getFOD_RO() == 3) && (BQ51.getFOD_RS() == BQ51_RS_FOD_2x));
+  uint8_t payload[4] = {1, 2, 3, 4};  uint8_t readBuff[BQ51_RXID_size];
+  BQ51.setPACKET_PAYLOAD(payload);
+  BQ51.getPACKET_PAYLOAD(readBuff);
+  check(memcmp(payload, readBuff, 4) == 0);
+  BQ51.setUSER_HEADER(0x18);
+  BQ51.setMAILBOX_SEND();
+  check(BQ51.getMAILBOX_SEND() == 0); // still sending
+  delay(sim.packetDuration_us / 1000 + 1);
+  check(BQ51.getMAILBOX_SEND() == 1);
+  check(BQ51.getMAILBOX_ERR() == BQ51_MAILBOX_ERR_good);
+  sim.setVRECT(0); // UVLO
+  check(BQ51.poweredCheck_mV() == -1);
+  check(BQ51.getVO_REG() == 5); // (config registers survive UVLO)
+  sim.setVRECT(7500 / BQ51_VOLT_SCALAR_mV);
+  check(BQ51.getUSER_HEADER() == 0); // (output registers don't)
+  BQ51.resetVO_REG();
+  {
+    BQ51_thijs_batch batch(BQ51);
+    uint8_t newPayload[4] = {5, 6, 7, 8};
+    batch.setVO_REG(3);  batch.setIO_REG(BQ51_ILIM_50);
+    batch.setFields(BQ51_FOD_RO_field::with(2) | BQ51_FOD_RS_field::with(BQ51_RS_FOD_3x));
+    batch.setUSER_HEADER(0x22);  batch.setPACKET_PAYLOAD(newPayload);
+    check(BQ51._errGood(batch.commit()));
+    check(batch.transactions <= 4); // 3 writes (+1 read for the FOD_RAM bits that weren't staged, without BQ51_useShadowCache)
+    check(!batch.pending());
+    BQ51.getPACKET_PAYLOAD(readBuff);
+    check((BQ51.getVO_REG() == 3) && (BQ51.getIO_REG() == BQ51_ILIM_50) && (BQ51.getFOD_RO() == 2) && (BQ51.getFOD_RS() == BQ51_RS_FOD_3x));
+    check((BQ51.getUSER_HEADER() == 0x22) && (memcmp(newPayload, readBuff, 4) == 0) && BQ51.getMAILBOX_SEND());
+    BQ51.resetAllRegisters();
+    check((BQ51.getVO_REG() == BQ51_VO_REG_default) && (BQ51.getFOD_RAM() == 0) && (BQ51.getUSER_HEADER() == 0));
+    BQ51.getPACKET_PAYLOAD(readBuff);
+    check((readBuff[0] == 0) && (readBuff[3] == 0));
+  }
+  {
+    BQ51_thijs_startup startup(BQ51);
+    sim.VOUTsettle_us = 50000; // (V_OUT takes 50ms to reach a new target)
+    startup.config.setVO_REG(4);  startup.config.setField<BQ51_FOD_RO_field>(1);
+    sim.setVRECT(0);  sim.resetStats();
+    check(BQ51._errGood(startup.begin()) && !startup.powered); // (not powered: only the probe read, the config stays staged)
+    check((sim.transactions == 1) && (sim.bytesTransferred == 2 + 1 + 4)); // (address + register, address + 0xE0 ~ 0xE3)
+    sim.setVRECT(7500 / BQ51_VOLT_SCALAR_mV);
+    check(BQ51._errGood(startup.begin()));
+    check(startup.powered && startup.settled);
+    check((startup.settleTime_us >= 50000) && (startup.settleTime_us < 80000));
+    check(startup.VOUT_mV == BQ51.getVOUT_mV());
+    check(startup.config.transactions == 2); // 2 burst writes, no reads (the FOD_RAM bits that weren't staged came from the probe read)
+    check((BQ51.getVO_REG() == 4) && (BQ51.getFOD_RO() == 1) && (BQ51.getFOD_RS() == BQ51_RS_FOD_1x));
+    printf("startup: %u transactions, V_OUT settled in %luus (%s), begin() took %luus\n", startup.transactions, (unsigned long)startup.settleTime_us,
+           startup.settled ? "settled" : "deadline", (unsigned long)startup.duration_us);
+    sim.VOUTsettle_us = 0;
+    BQ51.resetAllRegisters();
+  }
+  {
+    BQ51_thijs_packetQueue<2> packets(BQ51);
+    static uint8_t results[2];  static uint8_t resultCount;  resultCount = 0;
+    packets.setCallback([](const BQ51_packet& packet, BQ51_PACKET_RESULT_ENUM result, void*) { results[packet.id] = result;  resultCount++; });
+    packets.enqueue(0x18, payload, 0);
+    packets.enqueue(0x18, payload, 1);
+    for(uint16_t t=0; (t<1000) && (resultCount < 1); t++) { packets.pump();  delay(1); }
+    check((resultCount == 1) && (results[0] == BQ51_PACKET_sent));
+    packets.pump(); // (triggers the second packet)
+    delay(5);  sim.setVRECT(0);  sim.setVRECT(7500 / BQ51_VOLT_SCALAR_mV); // (UVLO reset halfway through sending)
+    for(uint16_t t=0; (t<1000) && (resultCount < 2); t++) { packets.pump();  delay(1); }
+    check((resultCount == 2) && (results[1] == BQ51_PACKET_reset)); // (not BQ51_PACKET_sent, even though the MAILBOX reads USER_PKT_DONE=1 and no error)
+  }
+  BQ51_thijs_variant<BQ51_CHIP_BQ5122x> BQ51222; // (same simulated device, but without the runtime isBQ51021 checks)
+  BQ51222.init(100000);
+  sim.MODE_IND = BQ51_MODE_IND_MODE_bits;
+  check(BQ51222.getMODE() == true);
+  {
+    BQ51_thijs_variant<BQ51_CHIP_BQ51021> BQ51021;
+    BQ51021.init(100000);
+    BQ51_telemetry telemetry;
+    sim.resetStats();
+    check(BQ51._errGood(BQ51021.readTelemetry(telemetry)) && (telemetry.MODE_IND == 0));
+    check((sim.transactions == 1) && (sim.bytesTransferred == 2 + 1 + 6)); // (address + register, address + 0xE3 ~ 0xE8, no MODE_IND)
+    //// the polling add-ons, with the chip known at compile time:
+    BQ51_thijs_presenceFor<BQ51_thijs_variant<BQ51_CHIP_BQ51021>> presence(BQ51021);
+    presence.begin();  sim.resetStats();
+    presence.poll(); // (due right away after begin())
+    check(presence.present && !presence.isPMA && (sim.transactions == 1) && (sim.bytesTransferred == 2 + 1 + 6)); // (no MODE_IND, and no RXID to confirm the arrival)
+    BQ51_thijs_sessionFor<BQ51_thijs_variant<BQ51_CHIP_BQ51021>> session(BQ51021);
+    sim.resetStats();
+    session.update();
+    check(session.active && (sim.transactions == 1) && (session.RXID()[0] == 0)); // (no RXID read)
+    BQ51_thijs_replayFor<BQ51_thijs_variant<BQ51_CHIP_BQ51021>> replay(BQ51021);
+    replay.includeMODE_IND = true;  sim.resetStats();
+    replay.update(telemetry);
+    check((sim.transactions == 1) && (sim.bytesTransferred == 2 + 1 + 9)); // (0xE0 ~ 0xE8, includeMODE_IND is ignored)
+    BQ51_thijs_replayFor<BQ51_thijs_variant<BQ51_CHIP_BQ5122x>> replay5122x(BQ51222);
+    replay5122x.includeMODE_IND = true;  sim.resetStats();
+    replay5122x.update(telemetry);
+    check((sim.transactions == 1) && (sim.bytesTransferred == 2 + 1 + 16) && (telemetry.MODE_IND == BQ51_MODE_IND_MODE_bits)); // (0xE0 ~ 0xEF)
+  }
+  sim.MODE_IND = 0;
+  {
+    BQ51_thijs_presence presence(BQ51);
+    static uint8_t eventCounts[3];  memset(eventCounts, 0, sizeof(eventCounts));
+    presence.setCallback([](BQ51_PRESENCE_EVENT_ENUM event, uint16_t, bool, void*) { eventCounts[event]++; });
+    sim.setVRECT(0);
+    presence.begin();
+    uint32_t placeTime = 0, arrivedTime = 0;
+    for(uint32_t t=0; t<4000; t++) { // (1ms steps) pad placed at 1s, PMA mode at 2s, pad removed at 3s
+      if(t == 1000) { sim.setVRECT(7500 / BQ51_VOLT_SCALAR_mV);  placeTime = millis(); }
+      if(t == 2000) { sim.MODE_IND = BQ51_MODE_IND_MODE_bits; }
+      if(t == 3000) { sim.setVRECT(0); }
+      if(presence.poll() && presence.present && (arrivedTime == 0)) { arrivedTime = millis(); }
+      delay(1);
+    }
+    sim.MODE_IND = 0;
+    check((eventCounts[BQ51_PRESENCE_arrived] == 1) && (eventCounts[BQ51_PRESENCE_lost] == 1) && (eventCounts[BQ51_PRESENCE_modeChanged] == 1));
+    check(!presence.present && (presence.period_ms == presence.maxAbsentPeriod_ms));
+    check((arrivedTime - placeTime) <= (uint32_t)(presence.maxAbsentPeriod_ms + presence.fastPeriod_ms * presence.debounceSamples));
+    check(presence.transactions < (4000 / presence.fastPeriod_ms / 2)); // (less than half of what polling at the fast rate would take)
+    printf("presence: %lu polls, %lu transactions in 4s, TX arrival noticed after %lums\n", (unsigned long)presence.polls,
+           (unsigned long)presence.transactions, (unsigned long)(arrivedTime - placeTime));
+    sim.setVRECT(7500 / BQ51_VOLT_SCALAR_mV);
+  }
+  {
+    BQ51_thijs_session session(BQ51);
+    static BQ51_sessionSummary ended;  static uint8_t endedCount = 0;
+    session.setCallback([](const BQ51_sessionSummary& summary, void*) { ended = summary;  endedCount++; });
+    sim.REC_PWR = 1000 / BQ51_WATT_SCALAR_mW; // (~1W for the first second, ~2W for the second one)
+    for(uint16_t t=0; t<2000; t+=10) {
+      if(t == 1000) { sim.REC_PWR = 2000 / BQ51_WATT_SCALAR_mW;  sim.setVRECT(8000 / BQ51_VOLT_SCALAR_mV); }
+      session.update();
+      delay(10);
+    }
+    check(session.active && (session.summary().samples == 200));
+    check(session.transactions == 201); // (200 telemetry reads and 1 RXID read)
+    sim.setVRECT(0);
+    session.update();  check(session.active); // (a single miss doesn't end the session)
+    session.update();  check(!session.active && (endedCount == 1));
+    check(memcmp(ended.RXID, sim.RXID, BQ51_RXID_size) == 0);
+    check((ended.VRECTmin_mV == (7500 / BQ51_VOLT_SCALAR_mV) * BQ51_VOLT_SCALAR_mV) && (ended.VRECTmax_mV == (8000 / BQ51_VOLT_SCALAR_mV) * BQ51_VOLT_SCALAR_mV));
+    check(ended.VRECTmean_mV == (ended.VRECTmin_mV + ended.VRECTmax_mV) / 2);
+    const uint32_t meanPower_mW = ((1000 / BQ51_WATT_SCALAR_mW) + (2000 / BQ51_WATT_SCALAR_mW)) * BQ51_WATT_SCALAR_mW / 2; // (equal time at both powers)
+    const uint32_t expectedEnergy_mJ = meanPower_mW * ended.duration_ms / 1000;
+    check((ended.energy_mJ > (expectedEnergy_mJ * 99 / 100)) && (ended.energy_mJ < (expectedEnergy_mJ * 101 / 100)));
+    printf("session: %lu samples, %lums, %lumJ, V_RECT %u/%u/%umV, peak %umW\n", (unsigned long)ended.samples, (unsigned long)ended.duration_ms,
+           (unsigned long)ended.energy_mJ, ended.VRECTmin_mV, ended.VRECTmean_mV, ended.VRECTmax_mV, ended.REC_PWRmax_mW);
+    sim.setVRECT(7500 / BQ51_VOLT_SCALAR_mV);
+    sim.REC_PWR = 2000 / BQ51_WATT_SCALAR_mW;
+    session.update();  delay(3600000UL);  session.update(); // (1 hour between samples, ~2W * 3600000ms doesn't fit in 32bits as uJ)
+    session.end();
+    check((endedCount == 2) && (ended.duration_ms >= 3600000UL));
+    check(ended.energy_mJ == (uint64_t)(2000 / BQ51_WATT_SCALAR_mW) * BQ51_WATT_SCALAR_mW * ended.duration_ms / 1000);
+    sim.REC_PWR = 2500 / BQ51_WATT_SCALAR_mW;
+  }
+  {
+    BQ51_thijs_headroom headroom(BQ51);
+    BQ51.resetVO_REG(); // (V_OUT ~5V, so ~2.5V of headroom at V_RECT ~7.5V)
+    headroom.maxBits = 3;
+    check(BQ51._errGood(headroom.begin()) && (headroom.steps == 0) && (headroom.VO_REG_bits() == BQ51_VO_REG_default));
+    headroom.update(); // (the first step is allowed right away)
+    check((headroom.steps == 1) && (BQ51.getVO_REG() == BQ51_VO_REG_default + 1));
+    delay(headroom.minStepInterval_ms / 2);
+    headroom.update();
+    check(headroom.steps == 1); // (rate limited)
+    for(uint8_t i=0; i<5; i++) { delay(headroom.minStepInterval_ms);  headroom.update(); }
+    check((headroom.VO_REG_bits() == 3) && (BQ51.getVO_REG() == 3)); // (clamped at maxBits, even though the headroom is still too large)
+    check(headroom.headroom_mV > (headroom.targetHeadroom_mV + headroom.hysteresis_mV));
+    headroom.maxBits = BQ51_VO_REG_bits;
+    for(uint8_t i=0; i<5; i++) { delay(headroom.minStepInterval_ms);  headroom.update(); }
+    check((headroom.VO_REG_bits() == 5) && (headroom.steps == 4)); // (V_OUT ~7V, ~500mV of headroom, inside the dead band)
+    check((headroom.headroom_mV + headroom.hysteresis_mV) >= headroom.targetHeadroom_mV);
+    check((headroom.savedPower_mW > 0) && (headroom.savedEnergy_mJ > 0));
+    int32_t savedEnergy_mJ = headroom.savedEnergy_mJ;
+    delay(3600000UL);  headroom.update(false); // (1 hour between updates, which doesn't fit in 32bits as uJ)
+    check((headroom.savedEnergy_mJ - savedEnergy_mJ) >= (int32_t)headroom.savedPower_mW * 3600);
+    check((headroom.savedEnergy_mJ - savedEnergy_mJ) <= (int32_t)headroom.savedPower_mW * 3601);
+    sim.setVRECT(7000 / BQ51_VOLT_SCALAR_mV); // (V_OUT is clamped to V_RECT, so no headroom at all)
+    headroom.minBits = 5;
+    delay(headroom.minStepInterval_ms);  headroom.update();
+    check((headroom.VO_REG_bits() == 5) && (headroom.steps == 4)); // (clamped at minBits)
+    headroom.minBits = 0;
+    delay(headroom.minStepInterval_ms);  headroom.update();
+    check((headroom.VO_REG_bits() == 4) && (BQ51.getVO_REG() == 4) && (headroom.steps == 5)); // (stepped down)
+    check(BQ51._errGood(headroom.end()) && (BQ51.getVO_REG() == BQ51_VO_REG_default));
+    sim.setVRECT(7500 / BQ51_VOLT_SCALAR_mV);
+  }
+  {
+    BQ51_thijs_replay replay(BQ51);
+    BQ51_telemetry telemetry;
+    replay.setFields(BQ51_FOD_RO_field::with(3) | BQ51_FOD_RS_field::with(BQ51_RS_FOD_2x));
+    check(BQ51._errGood(replay.update(telemetry)) && (replay.replays == 1) && (replay.transactions == 2)); // (1 read, 1 write)
+    check(telemetry.VRECT_mV == (7500 / BQ51_VOLT_SCALAR_mV) * BQ51_VOLT_SCALAR_mV);
+    replay.update(telemetry);
+    check((replay.replays == 1) && (replay.transactions == 3)); // (everything matches, so just the read)
+    sim.setVRECT(0); // (UVLO reset)
+    replay.update(telemetry);
+    check(replay.replays == 1); // (nothing is written while the registers are held in reset)
+    sim.setVRECT(7500 / BQ51_VOLT_SCALAR_mV);
+    replay.update(telemetry);
+    check((replay.replays == 2) && (BQ51.getFOD_RO() == 3) && (BQ51.getFOD_RS() == BQ51_RS_FOD_2x));
+    sim.setVRECT(0);  sim.setVRECT(7500 / BQ51_VOLT_SCALAR_mV);
+    check(BQ51._errGood(replay.apply()) && (BQ51.getFOD_RO() == 3)); // (like from a BQ51_PRESENCE_arrived callback)
+    BQ51.resetAllRegisters();
+  }
+  {
+    static uint8_t muxControl;  muxControl = 0;
+    BQ51_thijs_mux<2> mux([](uint8_t, uint8_t controlByte) { muxControl = controlByte;  return(true); });
+    check(mux.device(0) == NULL); // (nothing attached yet)
+    check(mux.attach(BQ51, 8) == 0xFF); // (channels are 0~7)
+    check((mux.attach(BQ51, 5) == 0) && (mux.attach(BQ51222, 2) == 1));
+    check((mux.device(0) == &BQ51) && (muxControl == (1 << 5)) && (mux.muxWrites == 1));
+    check((mux.device(0) == &BQ51) && (mux.muxWrites == 1)); // (already selected)
+    check((mux.device(2) == NULL) && (mux.muxWrites == 1)); // (invalid index, the mux is left alone)
+    check(!mux.select(2));
+  }
+  {
+    BQ51_thijs_fodcal fodcal(BQ51);
+    sim.REC_PWR = 2000 / BQ51_WATT_SCALAR_mW;  sim.ESRloss = 4; // (~2W load, ~156mW ESR loss)
+    fodcal.target_mW = 2300;
+    check(BQ51._errGood(fodcal.run()));
+    check((fodcal.steps == BQ51_FODCAL_STEPS) && (fodcal.trips == 0));
+    for(uint8_t i=1; i<fodcal.steps; i++) { check(fodcal.results[i-1].score <= fodcal.results[i].score); }
+    check((fodcal.results[0].score < BQ51_WATT_SCALAR_mW) && (fodcal.recommended == fodcal.results[0].FOD_RAM));
+    check(BQ51.getFOD_RAM() == fodcal.recommended);
+    check(fodcal.transactions == (uint32_t)(1 + BQ51_FODCAL_STEPS * (1 + fodcal.samplesPerStep) + 1)); // (1 read, 1 write + samplesPerStep reads per step, 1 final write)
+    printf("fodcal: %u steps in %lums, recommended FOD_RAM 0x%02X (RO %umW, RS %u permille, reports %umW)\n", fodcal.steps, (unsigned long)fodcal.duration_ms,
+           fodcal.recommended, BQ51_FOD_RO_field::decode(fodcal.recommended) * BQ51_WATT_SCALAR_mW,
+           BQ51_thijs::FOD_RS_permille(BQ51_FOD_RS_field::decode(fodcal.recommended)), fodcal.results[0].mean_mW);
+    sim.REC_PWR = 2500 / BQ51_WATT_SCALAR_mW;  sim.ESRloss = 0;
+    BQ51.resetAllRegisters();
+  }
+  #ifdef BQ51_useInstrumentation
+  {
+    BQ51_instrumentation& instr = BQ51.instrumentation;
+    uint8_t value = 0;
+    instr.reset();
+    BQ51.requestReadBytes(BQ51_VRECT_STATUS_RAM, readBuff, 3);
+    BQ51_telemetry telemetry;  BQ51.readTelemetry(telemetry); // (a 6 byte burst read at 0xE3, 0xE3 ~ 0xE8)
+    BQ51.writeBytes(BQ51_FOD_RAM, &value, 1);  BQ51.writeBytes(BQ51_FOD_RAM, &value, 1);
+    BQ51.onlyReadBytes(readBuff, 2);
+    BQ51.requestReadBytes(0x40, readBuff, 1); // (not a BQ51 register, counted in BQ51_INSTR_REG_misc)
+    const uint8_t VRECTindex = BQ51_instrumentation::regIndex(BQ51_VRECT_STATUS_RAM), FODindex = BQ51_instrumentation::regIndex(BQ51_FOD_RAM);
+    check((instr.perReg[VRECTindex].reads == 2) && (instr.perReg[VRECTindex].writes == 0) && (instr.perReg[VRECTindex].bytes == 3 + 6));
+    check((instr.perReg[FODindex].reads == 0) && (instr.perReg[FODindex].writes == 2) && (instr.perReg[FODindex].bytes == 2));
+    check((instr.perReg[BQ51_INSTR_REG_onlyRead].reads == 1) && (instr.perReg[BQ51_INSTR_REG_onlyRead].bytes == 2));
+    check((instr.perReg[BQ51_INSTR_REG_misc].reads == 1) && (instr.perReg[BQ51_INSTR_REG_misc].bytes == 1));
+    check((instr.perReg[VRECTindex].time > 0) && (instr.errorCodes == 0));
+    sim.present = false; // (every transaction NACKs)
+    BQ51_ERR_RETURN_TYPE err = BQ51.requestReadBytes(BQ51_VRECT_STATUS_RAM, readBuff, 3);
+    BQ51.requestReadBytes(BQ51_VRECT_STATUS_RAM, readBuff, 3);  BQ51.writeBytes(BQ51_FOD_RAM, &value, 1);
+    sim.present = true;
+    check((instr.perReg[VRECTindex].reads == 4) && (instr.perReg[VRECTindex].bytes == 3 + 6)); // (failed transactions count, their bytes don't)
+    check((instr.errorCodes == 1) && (instr.errors[0].code == err) && (instr.errors[0].count == 3)); // (all the same code, so 1 slot)
+    check(instr.otherErrors == 0);
+    uint32_t reads = 0, writes = 0, readHistogramTotal = 0, writeHistogramTotal = 0;
+    for(uint8_t i=0; i<BQ51_INSTR_REG_count; i++) { reads += instr.perReg[i].reads;  writes += instr.perReg[i].writes; }
+    for(uint8_t i=0; i<BQ51_INSTR_HIST_BUCKETS; i++) { readHistogramTotal += instr.readHistogram[i];  writeHistogramTotal += instr.writeHistogram[i]; }
+    check((reads == 6) && (writes == 3) && (readHistogramTotal == reads) && (writeHistogramTotal == writes));
+    check((instr.readHistogram[0] == 0) && (instr.writeHistogram[0] == 0)); // (every transaction takes bus time)
+  }
+  #endif
+  #ifdef BQ51_useTrace
+  {
+    uint8_t VO_REG;
+    BQ51.setPACKET_PAYLOAD(payload);
+    BQ51.trace.clear();
+    BQ51.getPACKET_PAYLOAD(readBuff); // (fills a slot with data)
+    for(uint16_t i=1; i<BQ51_TRACE_LENGTH; i++) { BQ51.requestReadBytes(BQ51_VO_REG, &VO_REG, 1); }
+    sim.present = false;
+    check(!BQ51._errGood(BQ51.requestReadBytes(BQ51_PACKET_PAYLOAD, readBuff, 4))); // (reuses the first slot)
+    sim.present = true;
+    const BQ51_traceEntry& entry = BQ51.trace[BQ51.trace.count() - 1];
+    check((entry.flags & BQ51_TRACE_ERR_bit) && (entry.length == 4));
+    for(uint8_t i=0; i<BQ51_TRACE_DATA_BYTES; i++) { check(entry.data[i] == 0); } // (no stale bytes from the previous transaction)
+    check(BQ51.trace[BQ51.trace.count() - 2].data[1] == 0); // (1 byte reads leave the rest of data[] empty)
+  }
+  {
+    uint8_t FOD = 0x15;
+    BQ51.trace.clear();
+    BQ51.writeBytes(BQ51_FOD_RAM, &FOD, 1);
+    BQ51.requestReadBytes(BQ51_VRECT_STATUS_RAM, readBuff, 3);
+    const BQ51_traceEntry& write = BQ51.trace[0];  const BQ51_traceEntry& read = BQ51.trace[1];
+    bufferStream stream;
+    BQ51.trace.dumpCSV(stream);
+    char expected[256];
+    snprintf(expected, sizeof(expected), "timestamp,duration,direction,register,length,result,ok,data\n%lu,%u,W,%u,1,%d,1,%u\n%lu,%u,R,%u,3,%d,1,%u %u %u\n",
+             (unsigned long)write.timestamp, write.duration, BQ51_FOD_RAM, (int)BQ51_ERR_GOOD, FOD,
+             (unsigned long)read.timestamp, read.duration, BQ51_VRECT_STATUS_RAM, (int)BQ51_ERR_GOOD, readBuff[0], readBuff[1], readBuff[2]);
+    check(strcmp(stream.text, expected) == 0);
+    BQ51.trace.dumpBinary(stream);
+    const uint8_t header[13] = {'B','Q','5','1','T', 1, BQ51_TRACE_DATA_BYTES, 2, 0, 2, 0, 0, 0}; // (2 entries, 2 recorded)
+    check((stream.binLength == sizeof(header) + 2 * (11 + BQ51_TRACE_DATA_BYTES)) && (memcmp(stream.bin, header, sizeof(header)) == 0));
+    const uint8_t* packed = &stream.bin[sizeof(header)]; // (the first entry, little-endian)
+    check((packed[0] | (packed[1] << 8) | (packed[2] << 16) | ((uint32_t)packed[3] << 24)) == write.timestamp);
+    check(((packed[4] | (packed[5] << 8)) == write.duration) && (packed[6] == BQ51_TRANSACTION_write) && (packed[7] == BQ51_FOD_RAM) && (packed[8] == 1));
+    check((int16_t)(packed[9] | (packed[10] << 8)) == (int16_t)BQ51_ERR_GOOD);
+    check((packed[11] == FOD) && (packed[12] == 0)); // (the rest of data[] is 0)
+    packed += 11 + BQ51_TRACE_DATA_BYTES; // (the second entry)
+    check((packed[6] == BQ51_TRANSACTION_read) && (packed[7] == BQ51_VRECT_STATUS_RAM) && (packed[8] == 3) && (memcmp(&packed[11], readBuff, 3) == 0));
+    check(write.duration > 0); // (so the duration bytes above weren't trivially 0)
+  }
+  #endif
+
+  //// benchmarks:
+  printf("\n");
+  bench("connectionCheck()", [](){ BQ51.connectionCheck(); });
+  bench("poweredCheck_mV()", [](){ BQ51.poweredCheck_mV(); });
+  bench("getVRECT()", [](){ BQ51.getVRECT(); });
+  bench("getVRECT+VOUT+REC_PWR", [](){ BQ51.getVRECT(); BQ51.getVOUT(); BQ51.getREC_PWR(); });
+  bench("readTelemetry()", [](){ BQ51_telemetry telemetry; BQ51.readTelemetry(telemetry); });
+  bench("readTelemetry(MODE_IND)", [](){ BQ51_telemetry telemetry; BQ51.readTelemetry(telemetry, true); });
+  bench("replay update() (no reset)", [](){ static BQ51_thijs_replay replay(BQ51);  replay.setField<BQ51_FOD_RO_field>(1);
+                                          BQ51_telemetry telemetry; replay.update(telemetry); });
+  bench("getRXID()", [](){ uint8_t RXID[BQ51_RXID_size]; BQ51.getRXID(RXID); });
+  bench("setVO_REG()", [](){ BQ51.setVO_REG(1); });
+  bench("setFOD_RO()", [](){ BQ51.setFOD_RO(1); });
+  bench("setFOD_RO()+setFOD_RS()", [](){ BQ51.setFOD_RO(1); BQ51.setFOD_RS(BQ51_RS_FOD_1x); });
+  bench("setFields(FOD_RO|FOD_RS)", [](){ BQ51.setFields(BQ51_FOD_RO_field::with(1) | BQ51_FOD_RS_field::with(BQ51_RS_FOD_1x)); });
+  bench("setMAILBOX_SEND()", [](){ BQ51.setMAILBOX_SEND(); });
+  bench("setPACKET_PAYLOAD()", [](){ uint8_t payload[4] = {1, 2, 3, 4}; BQ51.setPACKET_PAYLOAD(payload); });
+  bench("resetAllRegisters()", [](){ BQ51.resetAllRegisters(); });
+  bench("reconfigure (setters)", [](){ uint8_t payload[4] = {1, 2, 3, 4};
+    BQ51.setVO_REG(2); BQ51.setIO_REG(BQ51_ILIM_90); BQ51.setFOD_RO(1); BQ51.setFOD_RS(BQ51_RS_FOD_2x); BQ51.setUSER_HEADER(0x18); BQ51.setPACKET_PAYLOAD(payload); });
+  bench("reconfigure (batch)", [](){ uint8_t payload[4] = {1, 2, 3, 4}; BQ51_thijs_batch batch(BQ51);
+    batch.setVO_REG(2); batch.setIO_REG(BQ51_ILIM_90); batch.setFields(BQ51_FOD_RO_field::with(1) | BQ51_FOD_RS_field::with(BQ51_RS_FOD_2x)); batch.setUSER_HEADER(0x18); batch.setPACKET_PAYLOAD(payload);
+    batch.commit(); });
+
+  printf("\n%s (%u failed checks)\n", (failures == 0) ? "OK" : "FAILED", failures);
+  return((failures == 0) ? 0 : 1);
+}
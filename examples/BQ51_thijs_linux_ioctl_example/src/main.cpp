@@ -0,0 +1,161 @@
+/*
+
+this is a test of the Linux i2c-dev backend (BQ51_useLinuxI2C), against a stand-in for ioctl() (see BQ51_thijs::ioctlFunc)
+The stand-in records every I2C_RDWR call (so the message layout can be checked), emulates the BQ51 register map behind it,
+ and can fail on request (to check how errno values come out of the library functions).
+It also counts syscalls, compared to the usual write() + read() way of reading a register.
+It returns a non-zero exit code if anything is off, so it can be used in CI as well.
+
+*/
+
+#ifndef BQ51_useLinuxI2C
+  #define BQ51_useLinuxI2C  // (normally done through build_flags in platformio.ini)
+#endif
+
+#include <stdio.h>
+
+#include <BQ51_thijs.h>
+
+BQ51_thijs BQ51;
+
+uint8_t failures = 0;
+#define check(condition)  if(!(condition)) { printf("CHECK FAILED: %s (line %d)\n", #condition, __LINE__); failures++; }
+
+//// the stand-in:
+struct fakeMsg { uint16_t addr; uint16_t flags; uint16_t len; };
+struct {
+  unsigned long funcs = I2C_FUNC_I2C | I2C_FUNC_NOSTART; // what I2C_FUNCS reports
+  int failErrno = 0;    // if non-zero, the next I2C_RDWR fails with this errno
+  int partialCount = -1; // if >= 0, the next I2C_RDWR 'transfers' only this many messages
+  uint32_t syscalls = 0;
+  uint32_t transactions = 0; // STOP conditions on the (imaginary) wire
+  fakeMsg lastMsgs[4];  uint32_t lastCount = 0; // the messages of the last I2C_RDWR call
+  uint8_t lastWire[8];  uint8_t lastWireLength = 0; // the bytes of the last write, as they would appear on the wire
+  uint8_t regs[256] = {0};
+  uint8_t pointer = 0;
+} fake;
+
+/**
+ * stand-in for ioctl(), see BQ51_thijs::ioctlFunc
+ */
+int fakeIoctl(int fd, unsigned long request, void* arg) {
+  (void)fd;
+  fake.syscalls++;
+  if(request == I2C_FUNCS) { *(unsigned long*)arg = fake.funcs;  return(0); }
+  if(request != I2C_RDWR) { errno = ENOTTY;  return(-1); }
+  if(fake.failErrno != 0) { errno = fake.failErrno;  fake.failErrno = 0;  return(-1); }
+  struct i2c_rdwr_ioctl_data* data = (struct i2c_rdwr_ioctl_data*)arg;
+  fake.lastCount = data->nmsgs;  fake.lastWireLength = 0;
+  for(uint32_t i=0; i<data->nmsgs; i++) {
+    struct i2c_msg& msg = data->msgs[i];
+    if(i < 4) { fake.lastMsgs[i] = {msg.addr, msg.flags, msg.len}; }
+    if(msg.flags & I2C_M_RD) {
+      for(uint16_t j=0; j<msg.len; j++) { msg.buf[j] = fake.regs[fake.pointer++]; }
+    } else {
+      for(uint16_t j=0; j<msg.len; j++) {
+        if(fake.lastWireLength < sizeof(fake.lastWire)) { fake.lastWire[fake.lastWireLength++] = msg.buf[j]; }
+        if((j == 0) && !(msg.flags & I2C_M_NOSTART)) { fake.pointer = msg.buf[0]; } // (the first byte after a START is the register)
+        else { fake.regs[fake.pointer++] = msg.buf[j]; }
+      }
+    }
+  }
+  fake.transactions++; // (all messages of 1 I2C_RDWR call are 1 combined transaction, with a single STOP at the end)
+  if(fake.partialCount >= 0) { int count = fake.partialCount;  fake.partialCount = -1;  return(count); }
+  return(data->nmsgs);
+}
+
+//// the usual way (for comparison): write() the register, then read() the data. Each is its own syscall AND its own transaction
+void fakeWrite(const uint8_t* buff, uint8_t length) { fake.syscalls++;  fake.transactions++;  fake.pointer = buff[0]; (void)length; }
+void fakeRead(uint8_t* buff, uint8_t length) { fake.syscalls++;  fake.transactions++;  for(uint8_t i=0; i<length; i++) { buff[i] = fake.regs[fake.pointer++]; } }
+void writeReadRegister(uint8_t reg, uint8_t* buff, uint8_t length) { fakeWrite(&reg, 1);  fakeRead(buff, length); }
+
+int main() {
+  BQ51.ioctlFunc = fakeIoctl;
+  check(BQ51.init(3) == 0); // (any fd will do, the stand-in doesn't use it)
+  check(BQ51.canNoStart);
+  fake.regs[BQ51_VRECT_STATUS_RAM] = 7500 / BQ51_VOLT_SCALAR_mV;
+  fake.regs[BQ51_VOUT_STATUS_RAM] = 5000 / BQ51_VOLT_SCALAR_mV;
+  fake.regs[BQ51_REC_PWR_STATUS_RAM] = 2500 / BQ51_WATT_SCALAR_mW;
+
+  //// register read: a write message (the register), then a read message, in 1 call (so a repeated START, no STOP in between):
+  uint8_t readBuff[3];
+  check(BQ51.requestReadBytes(BQ51_VRECT_STATUS_RAM, readBuff, 3) == 0);
+  check(fake.lastCount == 2);
+  check((fake.lastMsgs[0].addr == BQ51.slaveAddress) && (fake.lastMsgs[0].flags == 0) && (fake.lastMsgs[0].len == 1));
+  check((fake.lastMsgs[1].addr == BQ51.slaveAddress) && (fake.lastMsgs[1].flags == I2C_M_RD) && (fake.lastMsgs[1].len == 3));
+  check((fake.lastWireLength == 1) && (fake.lastWire[0] == BQ51_VRECT_STATUS_RAM));
+  check(readBuff[0] == fake.regs[BQ51_VRECT_STATUS_RAM]);
+  BQ51_telemetry telemetry;
+  check(BQ51._errGood(BQ51.readTelemetry(telemetry)) && (telemetry.VOUT_mV == (5000 / BQ51_VOLT_SCALAR_mV) * BQ51_VOLT_SCALAR_mV));
+
+  //// only read: a single read message
+  check(BQ51.onlyReadBytes(readBuff, 2) == 0);
+  check((fake.lastCount == 1) && (fake.lastMsgs[0].flags == I2C_M_RD) && (fake.lastMsgs[0].len == 2));
+
+  //// write with I2C_M_NOSTART: the register and the (uncopied) data as 2 messages, which are 1 message on the wire
+  uint8_t payload[4] = {1, 2, 3, 4};
+  check(BQ51.writeBytes(BQ51_PACKET_PAYLOAD, payload, 4) == 0);
+  check(fake.lastCount == 2);
+  check((fake.lastMsgs[0].flags == 0) && (fake.lastMsgs[0].len == 1));
+  check((fake.lastMsgs[1].flags == I2C_M_NOSTART) && (fake.lastMsgs[1].len == 4));
+  check((fake.lastWireLength == 5) && (fake.lastWire[0] == BQ51_PACKET_PAYLOAD) && (memcmp(&fake.lastWire[1], payload, 4) == 0));
+  check(memcmp(&fake.regs[BQ51_PACKET_PAYLOAD], payload, 4) == 0);
+
+  //// write without I2C_M_NOSTART support: the register is copied in front of the data, 1 message
+  fake.funcs = I2C_FUNC_I2C;
+  check((BQ51.init(3) == 0) && !BQ51.canNoStart);
+  uint8_t payload2[4] = {5, 6, 7, 8};
+  check(BQ51.writeBytes(BQ51_PACKET_PAYLOAD, payload2, 4) == 0);
+  check((fake.lastCount == 1) && (fake.lastMsgs[0].flags == 0) && (fake.lastMsgs[0].len == 5));
+  check((fake.lastWireLength == 5) && (fake.lastWire[0] == BQ51_PACKET_PAYLOAD) && (memcmp(&fake.lastWire[1], payload2, 4) == 0));
+  check(memcmp(&fake.regs[BQ51_PACKET_PAYLOAD], payload2, 4) == 0);
+  BQ51.setVO_REG(3);
+  check(BQ51.getVO_REG() == 3);
+  fake.funcs = I2C_FUNC_I2C | I2C_FUNC_NOSTART;
+  BQ51.init(3);
+
+  //// errors: errno values come out as-is (BQ51_ERR_RETURN_TYPE is int, 0 means good)
+  fake.failErrno = ENXIO; // (address NACK)
+  int err = BQ51.requestReadBytes(BQ51_VRECT_STATUS_RAM, readBuff, 1);
+  check((err == ENXIO) && !BQ51._errGood(err));
+  fake.failErrno = ETIMEDOUT;
+  check(BQ51.writeBytes(BQ51_FOD_RAM, payload, 1) == ETIMEDOUT);
+  fake.failErrno = EREMOTEIO;
+  uint8_t VO_REG;
+  check(BQ51.getVO_REG(VO_REG) == EREMOTEIO); // (the high-level functions pass it on too)
+  fake.partialCount = 1; // (only the first message went through)
+  check(BQ51.requestReadBytes(BQ51_VRECT_STATUS_RAM, readBuff, 1) == EIO);
+  check(BQ51._errGood(BQ51.requestReadBytes(BQ51_VRECT_STATUS_RAM, readBuff, 1))); // (and back to normal)
+  fake.funcs = 0; // (an adapter without I2C_RDWR)
+  check(BQ51.init(3) == EOPNOTSUPP);
+  fake.funcs = I2C_FUNC_I2C | I2C_FUNC_NOSTART;
+  BQ51.init(3);
+
+  #ifdef BQ51_useInstrumentation
+  { //// errno values are distinct error codes, so (unlike the bool error type) they can fill every errors[] slot:
+    BQ51.instrumentation.reset();
+    const int errnos[] = {ENXIO, ETIMEDOUT, EREMOTEIO, EAGAIN, EBUSY, EINVAL, EPROTO, ENODEV}; // (2 more than the default BQ51_INSTR_ERR_SLOTS)
+    for(uint8_t i=0; i<(BQ51_INSTR_ERR_SLOTS + 2); i++) { fake.failErrno = errnos[i];  BQ51.requestReadBytes(BQ51_VRECT_STATUS_RAM, readBuff, 1); }
+    fake.failErrno = ENXIO;  BQ51.requestReadBytes(BQ51_VRECT_STATUS_RAM, readBuff, 1); // (a code that already has a slot)
+    check(BQ51.instrumentation.errorCodes == BQ51_INSTR_ERR_SLOTS);
+    check((BQ51.instrumentation.errors[0].code == ENXIO) && (BQ51.instrumentation.errors[0].count == 2));
+    check(BQ51.instrumentation.otherErrors == 2); // (the codes that didn't fit)
+  }
+  #endif
+
+  //// syscalls and transactions, compared to write() + read():
+  const uint16_t reads = 1000;
+  fake.syscalls = 0;  fake.transactions = 0;
+  for(uint16_t i=0; i<reads; i++) { BQ51.requestReadBytes(BQ51_VRECT_STATUS_RAM, readBuff, 3); }
+  uint32_t ioctlSyscalls = fake.syscalls, ioctlTransactions = fake.transactions;
+  fake.syscalls = 0;  fake.transactions = 0;
+  for(uint16_t i=0; i<reads; i++) { writeReadRegister(BQ51_VRECT_STATUS_RAM, readBuff, 3); }
+  uint32_t writeReadSyscalls = fake.syscalls, writeReadTransactions = fake.transactions;
+  check(ioctlSyscalls == reads);  check(writeReadSyscalls == 2 * reads);
+  check(ioctlTransactions == reads);  check(writeReadTransactions == 2 * reads);
+  printf("%u register reads: I2C_RDWR %lu syscalls, %lu transactions | write()+read() %lu syscalls, %lu transactions\n", reads,
+         (unsigned long)ioctlSyscalls, (unsigned long)ioctlTransactions, (unsigned long)writeReadSyscalls, (unsigned long)writeReadTransactions);
+
+  printf("\n%s (%u failed checks)\n", (failures == 0) ? "OK" : "FAILED", failures);
+  return((failures == 0) ? 0 : 1);
+}
@@ -14,8 +14,11 @@ The library should also work for the bq51221 and bq51021, but I haven't tested t
 //#define BQ51debugPrint(x)  log_d(x)  // ESP32 style logging
 
 #include <BQ51_thijs.h>
+#include <BQ51_thijs_startup.h>
+#include <BQ51_thijs_fodcal.h>
 
 BQ51_thijs BQ51;
+const uint16_t FODcalTarget_mW = 2500; // the received power the BQ51 should report under your test load (measure it on the transmitter side), see 'c' command
 //// NOTE: library does not include TS_CTRL pin interaction, that should be done seperately
 
 #ifdef ARDUINO_ARCH_ESP32  // on the ESP32, almost any pin can become an I2C pin
@@ -105,9 +108,11 @@ void setup()
   Serial.print("getRXID: "); for(uint8_t i=0; i<BQ51_RXID_size; i++) { Serial.print("0x"); Serial.print(readBuff[i], HEX); Serial.write('\t'); } Serial.println();
   Serial.println();
 
-  BQ51.setVO_REG(1); // set VOUT target to 5.0V (VO_REG to 500mV) (NOTE: this is the default setting at boot)
+  BQ51_thijs_startup startup(BQ51); // (instead of setting VO_REG and then waiting a fixed time, write the config and wait until V_OUT settles)
+  startup.config.setVO_REG(1); // set VOUT target to 5.0V (VO_REG to 500mV) (NOTE: this is the default setting at boot)
+  startup.begin();
   Serial.print("updated getVO_REG_volt: "); Serial.println(BQ51.getVO_REG_volt());
-  delay(250); // give the LDO some time to reach the new target voltage
+  Serial.print("V_OUT "); Serial.print(startup.settled ? "settled" : "did not settle"); Serial.print(" in "); Serial.print(startup.settleTime_us); Serial.println("us");
   // Serial.print("getVRECT: "); Serial.println(BQ51.getVRECT());
   Serial.print("getVRECT_volt: "); Serial.println(BQ51.getVRECT_volt());
   // Serial.print("getVOUT: "); Serial.println(BQ51.getVOUT());
@@ -152,12 +157,22 @@ void loop()
       BQ51.setFOD_RO(7); // set it to the highest value (opposite of default)
       BQ51.setFOD_OFF_EN(1);
       Serial.println(BQ51.getFOD_RO_mW());
+    } else if(recv == 'c') {
+      Serial.print("calibrating FOD for "); Serial.print(FODcalTarget_mW); Serial.println("mW...");
+      BQ51_thijs_fodcal fodcal(BQ51);
+      fodcal.target_mW = FODcalTarget_mW;
+      fodcal.run();
+      fodcal.dumpCSV(Serial);
+      Serial.print("recommended FOD_RAM: "); Serial.print(fodcal.recommended, BIN); Serial.print(" took "); Serial.print(fodcal.duration_ms); Serial.println("ms");
     } else { Serial.println("invalid input!"); }
   }
   // Serial.print(BQ51.getMODE_IND_ALIGN()); Serial.print('\t'); // i'm not sure what ALIGN mode does, but in the transmitters i've tested, it does absolutely nothing...
   // Serial.print("VRECT[v], VOUT[v], REC_PWR[W]:\t");
-  Serial.print(BQ51.getVRECT_volt()); Serial.print('\t');
-  Serial.print(BQ51.getVOUT_volt()); Serial.print('\t');
-  Serial.println(BQ51.getREC_PWR_watt());
+  BQ51_telemetry telemetry; // retrieve VRECT, VOUT and REC_PWR in a single I2C transaction
+  if(BQ51._errGood(BQ51.readTelemetry(telemetry))) {
+    Serial.print(telemetry.VRECT_volt); Serial.print('\t');
+    Serial.print(telemetry.VOUT_volt); Serial.print('\t');
+    Serial.println(telemetry.REC_PWR_watt);
+  } else { Serial.println("readTelemetry() failed!"); }
   delay(250);
 }
\ No newline at end of file